@@ -21,6 +21,9 @@ typedef struct
 } isp_lba_list;
 
 /* in-storage-processing API's */
+// connects to up to num_entries devices from the address list and returns their ids.
+// every device has its own sockets, calls on one device are serialized and calls on
+// different devices may run in parallel from different threads.
 isp_int ispGetDeviceIDs(isp_platform_id platform,
         isp_device_type device_type,
         isp_uint num_entries,
@@ -49,6 +52,15 @@ void ispRegisterCallbackFunction(isp_device_id device_id,
         const char* func_name,                                          // callback function name in the actor
         void(*func)(isp_device_id,void* data, int* data_size));       // callback function pointer in host
 
+// number of threads that run callbacks, set before ispGetDeviceIDs. the default is 4,
+// with more than one a slow callback does not delay the others but order is not kept.
+// the threads are shared by all devices, a callback gets the id of the calling device.
+void ispSetCallbackThreads(int num_threads);
+
+// addresses ispGetDeviceIDs connects to, host:port or port separated by commas, set
+// before ispGetDeviceIDs. the default is ISP_DEVICES from the environment or 127.0.0.1:5000.
+void ispSetDeviceAddresses(const char* addresses);
+
 // It supports two modes of execution: release and debug.
 // If debug mode is true then print callback function is called when a message is arrived.
 // After the callback function is resolved, execution of the script continues.
@@ -56,6 +68,7 @@ isp_int ispRunScript(isp_device_id device_id,
         int isp_debug_mode,
         void(*printFunction)(char* message));
 
+// close the device, its id is invalid afterwards and may be handed out again
 isp_int ispExit(isp_device_id device_id);
 
 // utility functions
@@ -75,4 +88,37 @@ isp_int ispRunBinaryFile(isp_device_id device_id, const char* program_file_name,
 
 isp_int ispRunBinaryFileEx(isp_device_id device_id, const char* program_file_name, const char* program_argument, const char* program_output_file, const int numprocs, const char* clocks);
 
+// ISP_RUN_NATIVE runs <program>.host (make host) on the host instead of gem5, as a fast
+// functional check. the cycles are then wall-clock plus the flash time modeled by s4lib.
+// a program without its .host binary is not run, the run or submit returns -1.
+// the default is ISP_RUN_GEM5, or ISP_RUN_NATIVE when ISP_RUN_MODE=native is set.
+#define ISP_RUN_GEM5	0
+#define ISP_RUN_NATIVE	1
+void ispSetRunMode(int mode);
+int ispGetRunMode();
+
+// asynchronous runs for sweeps.
+// a job runs in its own working directory (created if needed), which must hold the
+// program's input files; gem5_result.txt, io_stat.txt and m5out/ are written there.
+// at most ispSetMaxJobs jobs run at once, the default is the number of host cores.
+typedef int isp_job;
+
+isp_job ispSubmitBinaryFileEx(isp_device_id device_id, const char* workdir, const char* program_file_name, const char* program_argument, const char* program_output_file, const int numprocs, const char* clocks);
+
+// 1 when the job has finished, 0 while it is queued or running, -1 for an unknown job
+isp_int ispPollJob(isp_job job);
+
+// wait for every submitted job, returns the number of jobs that failed
+isp_int ispWaitAllJobs();
+
+// exit tick plus flash ticks of a job that finished with status 0, -1 otherwise
+long long ispJobCycle(isp_job job);
+
+// exit status of a finished job, 0 when it succeeded. -1 while it is queued or running,
+// and for a job that could not start or was killed by a signal
+isp_int ispJobStatus(isp_job job);
+const char* ispJobWorkdir(isp_job job);
+
+void ispSetMaxJobs(int max_jobs);
+
 #endif
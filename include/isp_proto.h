@@ -0,0 +1,77 @@
+#ifndef _ISP_PROTO_HEADER_
+#define _ISP_PROTO_HEADER_
+
+// wire format of the host <-> S4 device sockets.
+// every message is a 16 byte header followed by length payload bytes, all integers
+// in network byte order. the payload is a list of fields, each a 32-bit length and
+// that many bytes, so one message carries all parameters of a call at any size.
+// a reply carries the request id of the message it answers.
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define ISP_MSG_MAGIC		0x49535031	// "ISP1"
+#define ISP_MSG_HEADER_SIZE	16
+#define ISP_MSG_MAX_FIELDS	16
+#define ISP_MSG_MAX_LENGTH	(1u<<30)
+
+typedef enum {
+	ISP_MSG_REPLY = 1,		// fields of the answer, status first
+	// host -> device, command socket
+	ISP_MSG_ADD_SCRIPT,		// script
+	ISP_MSG_CLEAR_SCRIPT,
+	ISP_MSG_RUN_SCRIPT,
+	ISP_MSG_EXIT,
+	// device -> host, command socket while a script runs
+	ISP_MSG_PRINT,			// message
+	// device -> host, callback socket
+	ISP_MSG_CALLBACK_SEND,		// node, function, value
+	ISP_MSG_CALLBACK_RECEIVE,	// node, function, value; replied with the new value
+	ISP_MSG_S4_FOPEN,		// file name, mode; replied with a 32-bit handle
+	ISP_MSG_S4_FREAD,		// 64-bit size, 64-bit nitems, handle; replied with the data
+	ISP_MSG_S4_FCLOSE,		// handle
+	// host -> device, command socket
+	ISP_MSG_REGISTER_CALLBACK,	// node, function, 32-bit id; the device may then send
+					// callbacks as id, value instead of node, function, value
+	// host -> device, first message on both sockets, not replied
+	ISP_MSG_HELLO			// 64-bit session token, 32-bit role
+} isp_msg_type;
+
+#define ISP_ROLE_COMMAND	0
+#define ISP_ROLE_CALLBACK	1
+
+typedef struct
+{
+	int type;
+	uint32_t request_id;
+	uint32_t length;
+	char* payload;
+	uint32_t capacity;
+	// filled by ispRecvMsg
+	int num_fields;
+	const char* field[ISP_MSG_MAX_FIELDS];
+	uint32_t field_length[ISP_MSG_MAX_FIELDS];
+} isp_msg;
+
+// send header and fields in one writev, returns 0 on success
+int ispSendMsg(int fd, int type, uint32_t request_id, const struct iovec* fields, int num_fields);
+
+// read one message, the payload buffer of msg is reused and grown as needed.
+// returns the message type, 0 when the peer closed the socket and -1 on errors.
+int ispRecvMsg(int fd, isp_msg* msg);
+void ispMsgFree(isp_msg* msg);
+
+// field helpers, a missing field reads as 0 or ""
+uint32_t ispMsgU32(const isp_msg* msg, int index);
+uint64_t ispMsgU64(const isp_msg* msg, int index);
+// copy a field into a nul terminated string of at most size bytes
+const char* ispMsgString(const isp_msg* msg, int index, char* buffer, size_t size);
+
+// encode numbers for an iovec field, buffer must outlive the send
+struct iovec ispFieldU32(uint32_t* buffer, uint32_t value);
+struct iovec ispFieldU64(uint64_t* buffer, uint64_t value);
+struct iovec ispFieldString(const char* value);
+struct iovec ispFieldData(const void* data, size_t size);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _ISP_STATS_HEADER_
+#define _ISP_STATS_HEADER_
+
+// in-process collection of gem5 and s4lib statistics, one row per isp stage.
+// ticks are pico seconds and need 64 bits.
+
+typedef struct
+{
+	char stage[128];
+	long long sim_ticks;		// m5out/stats.txt sim_ticks, summed over the region dumps of S4_M5OPS kernels
+	long long exit_tick;		// gem5_result.txt "Exiting @ tick"
+	long long io_ticks;		// io_stat.txt "Exiting @ tick"
+	long long sim_insts;
+	long long icache_misses;	// summed over cpus
+	long long dcache_misses;
+	long long l2_misses;
+	long long read_pages;		// io_stat.txt s4.read_pages
+	long long program_pages;	// io_stat.txt s4.program_pages
+	long long regions;		// S4_M5OPS region dumps summed into the gem5 stats, 0 for a whole-run dump
+} isp_stage_stats;
+
+// "Exiting @ tick N" of a gem5 result or io_stat.txt file, 0 when there is none
+long long ispStatsReadTick(const char* fileName);
+
+// value of a "key value" line in a file, the last one wins when a key repeats
+int ispStatsReadValue(const char* fileName, const char* key, long long* value);
+
+// parse m5out/stats.txt, gem5_result.txt and io_stat.txt of the stage that just ran
+// and append them to the table under the given name. a stats.txt with S4_M5OPS region
+// dumps gives their sum, not gem5's exit dump after them
+isp_stage_stats* ispStatsCollect(const char* stage);
+
+// the same for a job that ran in its own working directory
+isp_stage_stats* ispStatsCollectDir(const char* stage, const char* dir);
+
+int ispStatsCount();
+isp_stage_stats* ispStatsGet(int index);
+
+// exit_tick+io_ticks summed over every collected stage
+long long ispStatsTotalTicks();
+
+// write the table as csv, returns 0 on success
+int ispStatsWrite(const char* fileName);
+void ispStatsClear();
+
+// file helpers for the drivers, so they do not fork cp/mv/rm
+int ispCopyFile(const char* src, const char* dst);
+int ispMoveFile(const char* src, const char* dst);
+
+#endif
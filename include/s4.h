@@ -6,21 +6,57 @@
 
 
 // simulation related variables and functions
-extern int s4_tick_time;
-void s4_spend_time(int theTick);
+// ticks are pico seconds, so they need 64 bits
+extern long long s4_tick_time;
+void s4_spend_time(long long theTick);
 
 void s4_init_simulation();
 void s4_wrapup_simulation();
 
+// thread count of the isp program, one main thread plus s4_numprocs()-1 workers.
+// it is read at run time from S4_NUMPROCS, which the host passes through gem5's
+// --env file, so one binary covers every core count of a sweep.
+// kernels size their per-thread arrays with S4_MAX_NUMPROCS.
+#ifndef S4_MAX_NUMPROCS
+#define S4_MAX_NUMPROCS 64
+#endif
+#ifndef S4_DEFAULT_NUMPROCS
+#define S4_DEFAULT_NUMPROCS 4
+#endif
+int s4_numprocs();
+
+// flash timing model
+// every page access is striped over channels x dies x planes units,
+// all pages of one s4_fread/s4_fwrite call are outstanding together
+typedef struct s4_flash_config{
+	long long read_latency;		// page read (array to register)
+	long long program_latency;	// page program (register to array)
+	long long erase_latency;	// block erase
+	long long transfer_latency;	// one page over the channel
+	int channels;
+	int dies;			// per channel
+	int planes;			// per die
+	int pages_per_block;
+} s4_flash_config;
+
+void s4_set_flash_config(const s4_flash_config* config);
+void s4_get_flash_config(s4_flash_config* config);
+
 // File related data structure
-#define S4_PAGE_SIZE 1024  
-#define S4_NUM_BUFFERS 1
-char s4_buffer[S4_PAGE_SIZE*S4_NUM_BUFFERS];
+// s4_buffer is a ring of S4_NUM_BUFFERS page slots used by the prefetch api
+#define S4_PAGE_SIZE 1024
+#ifndef S4_NUM_BUFFERS
+#define S4_NUM_BUFFERS 16
+#endif
+extern char s4_buffer[S4_PAGE_SIZE*S4_NUM_BUFFERS];
 
 // File related functions
 FILE *
 s4_fopen(const char * filename, const char * mode);
 
+int
+s4_fclose(FILE *stream);
+
 int
 s4_fseek(FILE *stream, long offset, int whence);
 
@@ -35,4 +71,40 @@ s4_pageread(size_t pageStartNumber, size_t numPages, FILE * stream);
 
 size_t
 s4_fwrite(const void * ptr, size_t size, size_t nitems, FILE * stream);
+
+// asynchronous read-ahead
+// s4_prefetch issues a page read and returns its ring slot, or -1 when all slots are in use.
+// s4_wait_page returns the page and charges only the latency compute has not covered.
+// s4_release_page gives the slot back to the ring.
+int
+s4_prefetch(FILE * stream, size_t pageNumber);
+
+char *
+s4_wait_page(int slot, size_t * nbytes);
+
+void
+s4_release_page(int slot);
+
+// read-only views of a file range, backed by mmap where the platform has it
+// and by a private copy otherwise. the pages of the range are charged as
+// read faults when the view is created. s4_unmap takes the pointer s4_map returned.
+const void *
+s4_map(FILE * stream, long offset, size_t length);
+
+void
+s4_unmap(const void * view);
+
+// named regions for per-phase timing, they nest per thread.
+// every thread keeps its own calls, ticks, i/o stall ticks, bytes read/written
+// by s4_ calls and items counted with s4_count_items, charged to its innermost
+// open region. s4_wrapup_simulation writes them to io_regions.csv.
+// built with -DS4_M5OPS (and gem5's util/m5 m5op.h and m5op_arm.S, make M5OPS=1 in
+// the app Makefiles) the outermost region also resets gem5 stats at begin and dumps
+// them at end. ispStatsCollect on the host sums those dumps.
+void s4_region_begin(const char* name);
+void s4_region_end(const char* name);
+void s4_count_items(long long n);
+
+// total seconds spent in a region over all threads and calls
+double s4_region_seconds(const char* name);
 #endif
@@ -3,13 +3,14 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include "s4.h"
 
 #define TRAN 10000
 #define ITEM 20
 #define LENGTH 10
 #define MIN 300
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 typedef struct aprioriset{
 	int length;
@@ -63,27 +64,27 @@ double readtime, makec1time, makectime, makeltime, mergetime, asstime, writetime
 
 void readapriorib(aprioristruct* data, FILE* fp){
 	data->num=TRAN;
-	fread(data->valuelist, sizeof(aprioriset), TRAN, fp);
+	s4_fread(data->valuelist, sizeof(aprioriset), TRAN, fp);
 }
 
 void saveapriorib(aprioristruct* data, FILE* fp){
-	fwrite(data->valuelist, sizeof(aprioriset), TRAN, fp);
+	s4_fwrite(data->valuelist, sizeof(aprioriset), TRAN, fp);
 }
 
 void readapriorinnb(aprioristruct* data, FILE* fp){
-	fread(data, sizeof(aprioristruct), 1, fp);
+	s4_fread(data, sizeof(aprioristruct), 1, fp);
 }
 
 void saveapriorinnb(aprioristruct* data, FILE* fp){
-	fwrite(data, sizeof(aprioristruct), 1, fp);
+	s4_fwrite(data, sizeof(aprioristruct), 1, fp);
 }
 
 void saveassstructb(aprioriassstruct* dest, FILE* fp){
-	fwrite(dest->aprioriasslist, sizeof(aprioriassvalue), dest->num, fp);
+	s4_fwrite(dest->aprioriasslist, sizeof(aprioriassvalue), dest->num, fp);
 }
 
 void saveassstructnnb(aprioriassstruct* dest, FILE* fp){
-	fwrite(dest, sizeof(aprioriassstruct), 1, fp);
+	s4_fwrite(dest, sizeof(aprioriassstruct), 1, fp);
 }
 
 void insertion(char* buf, char val, int length){
@@ -263,7 +264,7 @@ void loadapriorifromfile(aprioristruct* data, FILE* fp){
 }
 
 void loadapriorifromfileb(aprioristruct* dest, FILE* fp){
-	fread(dest, sizeof(aprioristruct), 1, fp);
+	s4_fread(dest, sizeof(aprioristruct), 1, fp);
 }
 
 void saveaprioritofile(aprioristruct* data, FILE* fp){
@@ -281,7 +282,7 @@ void saveaprioritofile(aprioristruct* data, FILE* fp){
 }
 
 void saveaprioritofileb(aprioristruct* dest, FILE* fp){
-	fwrite(dest, sizeof(aprioristruct), 1, fp);
+	s4_fwrite(dest, sizeof(aprioristruct), 1, fp);
 }
 
 void makec1(aprioristruct* target, aprioristruct* data){
@@ -324,18 +325,18 @@ arg->c->support=0;
 void genL(aprioristruct* l, aprioristruct* c, aprioristruct* data, int minnum){
 	int ccount=0, cdatacount=0, datacount, i, j;
 	aprioriset* nowdata;
-	pthread_t thread[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
 	genlstruct* genlstructs=(genlstruct*)malloc(sizeof(genlstruct)*c->num);
 	if(c->num<GEM5_NUMPROCS){
-		for(ccount=0;ccount<c->num;ccount++){
+		for(ccount=0;ccount<c->num && ccount<S4_MAX_NUMPROCS;ccount++){
 			genlstructs[ccount].c=&c->valuelist[ccount];
 			genlstructs[ccount].data=data;
 			pthread_create(&thread[ccount], NULL, genlthreadfunc, (void*)&genlstructs[ccount]);
 		}
-		for(ccount=0;ccount<c->num;ccount++){
+		for(ccount=0;ccount<c->num && ccount<S4_MAX_NUMPROCS;ccount++){
 			pthread_join(thread[ccount], NULL);
 		}
-		for(ccount=0;ccount<c->num;ccount++){
+		for(ccount=0;ccount<c->num && ccount<S4_MAX_NUMPROCS;ccount++){
 			nowdata=&c->valuelist[ccount];
 			if(nowdata->support<minnum){
 				deleteaprioriset(&nowdata);
@@ -432,28 +433,28 @@ void* gencthreadfunc(void* thearg){
 }
 
 void genC(aprioristruct* c, aprioristruct* l){
-	pthread_t thread[GEM5_NUMPROCS];
-	gencstruct strarg[GEM5_NUMPROCS];
-	gencstruct strarg2[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	gencstruct strarg[S4_MAX_NUMPROCS];
+	gencstruct strarg2[S4_MAX_NUMPROCS];
 	gencstruct* parg;
 	int length=l->valuelist[0].length;
-	int threadrun[GEM5_NUMPROCS]={0,};
-	int threadrun2[GEM5_NUMPROCS]={0,};
+	int threadrun[S4_MAX_NUMPROCS]={0,};
+	int threadrun2[S4_MAX_NUMPROCS]={0,};
 	int* pthreadrun;
 	int i, j, count=0, toggle=0, ccount=0;
 
 	if(l->num<GEM5_NUMPROCS){
-		for(i=0;i<l->num;i++){
+		for(i=0;i<l->num && i<S4_MAX_NUMPROCS;i++){
 			strarg[i].l=l;
 			strarg[i].s=&l->valuelist[i];
 			strarg[i].length=length;
 			strarg[i].num=i+1;
 			pthread_create(&thread[i], NULL, gencthreadfunc, (void*)&strarg[i]);
 		}
-		for(i=0;i<l->num;i++){
+		for(i=0;i<l->num && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
-		for(i=0;i<l->num;i++){
+		for(i=0;i<l->num && i<S4_MAX_NUMPROCS;i++){
 			for(j=0;j<strarg[i].ret.num;j++){
 				if(strarg[i].ret.proper[j]){
 					add(c, &strarg[i].ret.valuelist[j], 1);
@@ -553,10 +554,10 @@ void* getassociationrulefunc(void* thearg){
 void getassociationrule(aprioriassstruct* dest, aprioristruct* list){
 	aprioriset* right, *left;
 	int i, j, k;
-	pthread_t thread[GEM5_NUMPROCS];
-	associationstruct assstruct[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	associationstruct assstruct[S4_MAX_NUMPROCS];
 	int proccount=0;
-	int threadrun[GEM5_NUMPROCS]={0,};
+	int threadrun[S4_MAX_NUMPROCS]={0,};
 	for(i=0;i<list->num;i++){
 		right=&list->valuelist[i];
 		if(right->length<2)
@@ -593,18 +594,30 @@ void getassociationrule(aprioriassstruct* dest, aprioristruct* list){
 int apriori(){
 	aprioristruct result;
 	aprioriassstruct ass={0,};
-	FILE* input=fopen("merged", "rb");
-	FILE* output=fopen("ass", "wb");
+	FILE* input=s4_fopen("merged", "rb");
+	FILE* output=s4_fopen("ass", "wb");
+	s4_region_begin("read");
 	readapriorinnb(&result, input);
-getassociationrule(&ass, &result);
-
+	s4_region_end("read");
+	readtime=s4_region_seconds("read");
+	s4_region_begin("genass");
+	getassociationrule(&ass, &result);
+	s4_count_items(result.num);
+	s4_region_end("genass");
+	asstime=s4_region_seconds("genass");
+
+	s4_region_begin("write");
 	saveassstructnnb(&ass, output);
-fclose(output);
-	fclose(input);
+	s4_region_end("write");
+	writetime=s4_region_seconds("write");
+s4_fclose(output);
+	s4_fclose(input);
 	return 0;
 }
 
 int main(){
+	s4_init_simulation();
 	apriori();
+	s4_wrapup_simulation();
 	return 0;
 }
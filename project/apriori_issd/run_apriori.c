@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "isp.h"
+#include "isp_stats.h"
 
 #define issd_clock 400
 #define issd_numcpu 4
@@ -19,79 +20,83 @@ int main(int argc, const char* argv[])
 	char funcname[64];
 	int numcpu=issd_numcpu;
 	int clock=issd_clock;
+	if(argc>1) numcpu=atoi(argv[1]);
+	if(argc>2) clock=atoi(argv[2]);
 	sprintf(cpuhz, "%dMHz", clock);
 	sprintf(funcname, "read");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makec1");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makel1");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makec2");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makel2");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makec3");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makel3");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makec4");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makel4");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "merge");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "genass");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "write");
 	sprintf(pname, "./apriori_isp_%s", funcname);
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/apriori_%s_%d_%s.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "apriori_%s_%d_%s", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
-	printf("ISP cycle = %d\n", cycle);
+	sprintf(cmd, "./m5out/apriori_stats_%d_%s.csv", numcpu, cpuhz);
+	ispStatsWrite(cmd);
+	printf("ISP cycle = %lld\n", ispStatsTotalTicks());
 return 0;
 }
@@ -1,11 +1,14 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #define MAX_ATTR_NUM 19
 #define MAX_ATTR_VAL 33
 #define MAX_INFO_VAL 10
-#define TRAIN_N 700
-#define TEST_N 150
+#define MAX_CONVERT_THREADS 64
+#define NO_CLASS 255
 #define MAX_TREE_NUM 2227//500
 
 #define ATTR_MAX {9,	16,	15,	33,	4,	10,	8,	4,	6,	6,	3,	17,	5,	4,	2,	2,	2,	2,	2}
@@ -34,34 +37,266 @@ typedef struct dicisiontree{
 	struct treenode node[MAX_TREE_NUM];
 }dicisiontree;
 
-void read(value* dest, FILE* fp){
+// dataset file : rows, attrs, classes and card[attrs] ints, then attrs
+// columns of rows unsigned chars and the class column. a row without a
+// class has NO_CLASS.
+typedef struct dataschema{
+	int rows;
+	int attrs;
+	int classes;
+	int* card;
+}dataschema;
+
+// a chunk of the text, cut at line ends. the first pass counts its rows,
+// the second parses them into the columns at row first.
+typedef struct parsestruct{
+	char* start;
+	char* end;
+	int cols;
+	int rows;
+	int first;
+	int total;
+	unsigned char* data;
+	int* max;
+	int errrow;
+}parsestruct;
+
+char* loadtext(const char* name, long* len){
+	FILE* fp=fopen(name, "rb");
+	char* text;
+
+	if(fp==NULL)
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	*len=ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	text=malloc(*len+1);
+	*len=fread(text, 1, *len, fp);
+	text[*len]='\0';
+	fclose(fp);
+	return text;
+}
+
+// number of values on the first line holding any
+int countcols(char* p, char* end){
+	int c;
+
+	while(p<end){
+		c=0;
+		while(p<end&&*p!='\n'){
+			if(*p>='0'&&*p<='9'){
+				c++;
+				while(p<end&&*p>='0'&&*p<='9')
+					p++;
+			}
+			else
+				p++;
+		}
+		if(c>0)
+			return c;
+		p++;
+	}
+	return 0;
+}
+
+void* countfunc(void* thearg){
+	parsestruct* arg=(parsestruct*)thearg;
+	char* p=arg->start;
+	char* end=arg->end;
+	int digit;
+
+	arg->rows=0;
+	while(p<end){
+		digit=0;
+		while(p<end&&*p!='\n'){
+			if(*p>='0'&&*p<='9')
+				digit=1;
+			p++;
+		}
+		p++;
+		arg->rows+=digit;
+	}
+}
+
+// values are parsed by hand instead of with fscanf and stored column-wise.
+// a value over 255, a sign or a short row marks the row as bad.
+void* parsefunc(void* thearg){
+	parsestruct* arg=(parsestruct*)thearg;
+	char* p=arg->start;
+	char* end=arg->end;
+	int cols=arg->cols;
+	int total=arg->total;
+	unsigned char* data=arg->data;
+	int* max=arg->max;
+	int row=arg->first;
+	int c, v;
+
+	arg->errrow=-1;
+	while(p<end){
+		c=0;
+		while(p<end&&*p!='\n'){
+			if(*p>='0'&&*p<='9'){
+				v=0;
+				while(p<end&&*p>='0'&&*p<='9'){
+					v=v*10+(*p-'0');
+					if(v>255)
+						v=256;
+					p++;
+				}
+				if(c<cols){
+					if(v>255&&arg->errrow<0)
+						arg->errrow=row;
+					data[c*total+row]=(unsigned char)v;
+					if(v>max[c])
+						max[c]=v;
+				}
+				c++;
+			}
+			else{
+				if(*p!=' '&&*p!='\t'&&*p!='\r'&&arg->errrow<0)
+					arg->errrow=row;
+				p++;
+			}
+		}
+		p++;
+		if(c==0)
+			continue;
+		if(c<cols&&arg->errrow<0)
+			arg->errrow=row;
+		row++;
+	}
+}
+
+// parses a text file of rows of small ints into cols columns of rows bytes
+// with one thread per chunk. max gets the largest value of every column.
+unsigned char* parsefile(const char* name, int* rows, int* cols, int** max){
+	char* text;
+	long len;
+	int nthread;
 	int i, j;
-	for(i=0;i<TRAIN_N;i++){
-		for(j=0;j<MAX_ATTR_NUM;j++){
-			fscanf(fp, "%d", &dest[i].attr[j]);
+	char* p;
+	unsigned char* data;
+	pthread_t thread[MAX_CONVERT_THREADS];
+	parsestruct structs[MAX_CONVERT_THREADS];
+
+	text=loadtext(name, &len);
+	if(text==NULL){
+		printf("can not open %s\n", name);
+		exit(1);
+	}
+	*cols=countcols(text, text+len);
+	nthread=sysconf(_SC_NPROCESSORS_ONLN);
+	if(nthread<1)
+		nthread=1;
+	if(nthread>MAX_CONVERT_THREADS)
+		nthread=MAX_CONVERT_THREADS;
+
+	p=text;
+	for(i=0;i<nthread;i++){
+		structs[i].start=p;
+		p=text+len*(i+1)/nthread;
+		if(p<structs[i].start)
+			p=structs[i].start;
+		// a boundary at the start of a short file stays an empty chunk
+		while(p>text&&p<text+len&&*(p-1)!='\n')
+			p++;
+		structs[i].end=p;
+		structs[i].cols=*cols;
+		pthread_create(&thread[i], NULL, countfunc, (void*)&structs[i]);
+	}
+	for(i=0;i<nthread;i++){
+		pthread_join(thread[i], NULL);
+	}
+	*rows=0;
+	for(i=0;i<nthread;i++){
+		structs[i].first=*rows;
+		*rows+=structs[i].rows;
+	}
+
+	data=malloc((long)(*rows)*(*cols)+1);
+	for(i=0;i<nthread;i++){
+		structs[i].total=*rows;
+		structs[i].data=data;
+		structs[i].max=calloc(*cols, sizeof(int));
+		pthread_create(&thread[i], NULL, parsefunc, (void*)&structs[i]);
+	}
+	for(i=0;i<nthread;i++){
+		pthread_join(thread[i], NULL);
+	}
+	*max=calloc(*cols, sizeof(int));
+	for(i=0;i<nthread;i++){
+		if(structs[i].errrow>=0){
+			printf("%s row %d : short row or value out of 0..255\n", name, structs[i].errrow);
+			exit(1);
 		}
-		fscanf(fp, "%d", &dest[i].res);
+		for(j=0;j<*cols;j++){
+			if(structs[i].max[j]>(*max)[j])
+				(*max)[j]=structs[i].max[j];
+		}
+		free(structs[i].max);
+	}
+	free(text);
+	return data;
+}
+
+// the cardinality of an attribute is its largest value in either set plus one
+void makeschema(dataschema* schema, int* trainmax, int* testmax, int attrs){
+	int j;
+
+	schema->attrs=attrs;
+	schema->classes=trainmax[attrs]+1;
+	schema->card=calloc(attrs, sizeof(int));
+	for(j=0;j<attrs;j++){
+		schema->card[j]=trainmax[j]+1;
+		if(testmax[j]+1>schema->card[j])
+			schema->card[j]=testmax[j]+1;
 	}
 }
 
-void readtest(value* dest, FILE* fp){
+void saveset(dataschema* schema, unsigned char* data, int rows, int cols, FILE* fp){
+	unsigned char* noclass;
+	int j;
+
+	fwrite(&rows, 1, sizeof(int), fp);
+	fwrite(&schema->attrs, 1, sizeof(int), fp);
+	fwrite(&schema->classes, 1, sizeof(int), fp);
+	fwrite(schema->card, schema->attrs, sizeof(int), fp);
+	for(j=0;j<schema->attrs;j++){
+		fwrite(&data[(long)j*rows], 1, rows, fp);
+	}
+	if(cols>schema->attrs)
+		fwrite(&data[(long)schema->attrs*rows], 1, rows, fp);
+	else{
+		noclass=malloc(rows+1);
+		memset(noclass, NO_CLASS, rows);
+		fwrite(noclass, 1, rows, fp);
+		free(noclass);
+	}
+}
+
+// value records for the per-stage binaries, which keep MAX_ATTR_NUM fixed
+value* makevalue(unsigned char* data, int rows, int cols, int attrs){
+	value* val=calloc(rows, sizeof(value));
 	int i, j;
-	for(i=0;i<TEST_N;i++){
-		for(j=0;j<MAX_ATTR_NUM;j++){
-			fscanf(fp, "%d", &dest[i].attr[j]);
+
+	for(i=0;i<rows;i++){
+		for(j=0;j<attrs;j++){
+			val[i].attr[j]=data[(long)j*rows+i];
 		}
+		val[i].res=(cols>attrs)?data[(long)attrs*rows+i]:-1;
 	}
+	return val;
 }
 
-void printtest(value* dest){
+void printtest(value* dest, int num){
 	int i;
-	for(i=0;i<TEST_N;i++){
+	for(i=0;i<num;i++){
 		printf("%d\n", dest[i].res);
 	}
 }
-void fprinttest(value* dest, FILE* fp){
+void fprinttest(value* dest, FILE* fp, int num){
 	int i, j;
-	for(i=0;i<TEST_N;i++){
+	for(i=0;i<num;i++){
 		for(j=0;j<MAX_ATTR_NUM;j++){
 			fprintf(fp, "%d\t", dest[i].attr[j]);
 		}
@@ -111,25 +346,58 @@ void savetree(dicisiontree* dest, FILE* fp){
 
 
 int main(){
-	value val[TRAIN_N];
-	value tval[TEST_N];
-	FILE* valinput=fopen("data.txt", "r");
-	FILE* valoutput=fopen("val", "wb");
-	FILE* tvalinput=fopen("test.txt", "r");
-	FILE* tvaloutput=fopen("testval", "wb");
-
-FILE* tvalout2=fopen("testval2.txt", "w");
-	
-	read(val, valinput);
-	readtest(tval, tvalinput);
-	
-	savevalb(val, valoutput, TRAIN_N);
-	savevalb(tval, tvaloutput, TEST_N);
-fprinttest(tval, tvalout2);
-fclose(tvalout2);
-	fclose(valinput);
+	unsigned char* train;
+	unsigned char* test;
+	int* trainmax;
+	int* testmax;
+	int ntrain, ntest;
+	int traincols, testcols;
+	value* val;
+	value* tval;
+	dataschema schema;
+	FILE* valoutput;
+	FILE* tvaloutput;
+	FILE* tvalout2;
+
+	train=parsefile("data.txt", &ntrain, &traincols, &trainmax);
+	test=parsefile("test.txt", &ntest, &testcols, &testmax);
+	if(testcols!=traincols-1&&testcols!=traincols){
+		printf("data.txt has %d columns, test.txt %d\n", traincols, testcols);
+		return 1;
+	}
+	makeschema(&schema, trainmax, testmax, traincols-1);
+	if(schema.classes>=NO_CLASS){
+		printf("%d classes do not fit a byte column\n", schema.classes);
+		return 1;
+	}
+	printf("train %d rows, test %d rows, %d attributes, %d classes\n", ntrain, ntest, schema.attrs, schema.classes);
+
+	valoutput=fopen("trainset", "wb");
+	saveset(&schema, train, ntrain, traincols, valoutput);
 	fclose(valoutput);
-	fclose(tvalinput);
+	tvaloutput=fopen("testset", "wb");
+	saveset(&schema, test, ntest, testcols, tvaloutput);
 	fclose(tvaloutput);
+
+	if(schema.attrs<=MAX_ATTR_NUM){
+		val=makevalue(train, ntrain, traincols, schema.attrs);
+		tval=makevalue(test, ntest, testcols, schema.attrs);
+		valoutput=fopen("val", "wb");
+		savevalb(val, valoutput, ntrain);
+		fclose(valoutput);
+		tvaloutput=fopen("testval", "wb");
+		savevalb(tval, tvaloutput, ntest);
+		fclose(tvaloutput);
+		tvalout2=fopen("testval2.txt", "w");
+		fprinttest(tval, tvalout2, ntest);
+		fclose(tvalout2);
+		free(val);
+		free(tval);
+	}
+	free(train);
+	free(test);
+	free(trainmax);
+	free(testmax);
+	free(schema.card);
 	return 0;
 }
@@ -1,11 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #define MAX_ATTR_NUM 19
 #define MAX_ATTR_VAL 33
 #define MAX_INFO_VAL 10
-#define TRAIN_N 700
-#define TEST_N 150
-#define MAX_TREE_NUM 2227//500
 
 #define ATTR_MAX {9,	16,	15,	33,	4,	10,	8,	4,	6,	6,	3,	17,	5,	4,	2,	2,	2,	2,	2}
 
@@ -30,38 +28,19 @@ typedef struct treenode{
 typedef struct dicisiontree{
 	int num;
 	int maxnum;
-	struct treenode node[MAX_TREE_NUM];
+	struct treenode* node;
 }dicisiontree;
 
 
-void read(value* dest, FILE* fp){
-	int i, j;
-	for(i=0;i<TRAIN_N;i++){
-		for(j=0;j<MAX_ATTR_NUM;j++){
-			fscanf(fp, "%d", &dest[i].attr[j]);
-		}
-		fscanf(fp, "%d", &dest[i].res);
-	}
-}
-
-void readtest(value* dest, FILE* fp){
-	int i, j;
-	for(i=0;i<TEST_N;i++){
-		for(j=0;j<MAX_ATTR_NUM;j++){
-			fscanf(fp, "%d", &dest[i].attr[j]);
-		}
-	}
-}
-
-void printtest(value* dest){
+void printtest(value* dest, int num){
 	int i;
-	for(i=0;i<TEST_N;i++){
+	for(i=0;i<num;i++){
 		printf("%d\n", dest[i].res);
 	}
 }
-void fprinttest(value* dest, FILE* fp){
+void fprinttest(value* dest, FILE* fp, int num){
 	int i, j;
-	for(i=0;i<TEST_N;i++){
+	for(i=0;i<num;i++){
 		for(j=0;j<MAX_ATTR_NUM;j++){
 			fprintf(fp, "%d\t", dest[i].attr[j]);
 		}
@@ -69,9 +48,9 @@ void fprinttest(value* dest, FILE* fp){
 	}
 }
 
-void fprinttrain(value* dest, FILE* fp){
+void fprinttrain(value* dest, FILE* fp, int num){
 	int i, j;
-	for(i=0;i<TRAIN_N;i++){
+	for(i=0;i<num;i++){
 		for(j=0;j<MAX_ATTR_NUM;j++){
 			fprintf(fp, "%d\t", dest[i].attr[j]);
 		}
@@ -83,7 +62,7 @@ void savetreet(dicisiontree* tree, FILE* fp){
 	int i, j;
 	treenode* node;
 	fprintf(fp, "maxnum : %d\n", tree->maxnum);
-	for(i=0;i<MAX_TREE_NUM;i++){
+	for(i=0;i<tree->maxnum;i++){
 		node=&tree->node[i];
 		fprintf(fp, "node %d\ntreeval %d\nstartnum %d\nnum %d\nattnum %d\nlistcount : ", i, node->treeval, node->startnum, node->num, node->attnum);
 		for(j=0;j<MAX_ATTR_VAL;j++){
@@ -100,13 +79,31 @@ void savetreet(dicisiontree* tree, FILE* fp){
 void readvalb(value* dest, FILE* fp, int num){
 	fread(dest, num, sizeof(value), fp);
 }
+// the row count of a value file comes from its size
+value* readvalf(FILE* fp, int* num){
+	value* dest;
+
+	fseek(fp, 0, SEEK_END);
+	*num=ftell(fp)/sizeof(value);
+	fseek(fp, 0, SEEK_SET);
+	dest=malloc(sizeof(value)*(*num));
+	readvalb(dest, fp, *num);
+	return dest;
+}
 
 void readinfob(float* info, FILE* fp, int num){
 	fread(info, num, sizeof(float), fp);
 }
 
-void readtree(dicisiontree* dest, FILE* fp){
-	fread(dest, 1, sizeof(dicisiontree), fp);
+// tree file : num and maxnum, then at least maxnum nodes. train writes the
+// maxnum it made, the per-stage kernels their whole table. -1 if it is short.
+int readtree(dicisiontree* dest, FILE* fp){
+	if(fp==NULL||fread(&dest->num, sizeof(int), 1, fp)!=1||fread(&dest->maxnum, sizeof(int), 1, fp)!=1||dest->maxnum<=0)
+		return -1;
+	dest->node=malloc(sizeof(treenode)*dest->maxnum);
+	if(dest->node==NULL||fread(dest->node, sizeof(treenode), dest->maxnum, fp)!=dest->maxnum)
+		return -1;
+	return 0;
 }
 void savevalb(value* dest, FILE* fp, int num){
 	fwrite(dest, num, sizeof(value), fp);
@@ -116,9 +113,6 @@ void saveinfob(float* info, FILE* fp, int num){
 	fwrite(info, num, sizeof(float), fp);
 }
 
-void savetree(dicisiontree* dest, FILE* fp){
-	fwrite(dest, 1, sizeof(dicisiontree), fp);
-}
 
 
 
@@ -126,9 +120,10 @@ void savetree(dicisiontree* dest, FILE* fp){
 
 
 int main(){
-	value val[TRAIN_N];
-	value tval[TEST_N];
-	dicisiontree tree;
+	value* val;
+	value* tval;
+	int num;
+	static dicisiontree tree;
 	FILE* treeinput=fopen("tree", "rb");
 	FILE* treeoutput=fopen("treeout.txt", "w");
 	FILE* tvalinput=fopen("test2.txt", "w");
@@ -136,16 +131,20 @@ int main(){
 	FILE* valinput=fopen("val22.txt", "w");
 	FILE* valoutput=fopen("val", "rb");
 	
-	readvalb(tval, tvaloutput, TEST_N);
-	fprinttest(tval, tvalinput);
+	tval=readvalf(tvaloutput, &num);
+	fprinttest(tval, tvalinput, num);
+	free(tval);
 	fclose(tvalinput);
 	fclose(tvaloutput);
-	readtree(&tree, treeinput);
-	savetreet(&tree, treeoutput);
+	if(readtree(&tree, treeinput)==0)
+		savetreet(&tree, treeoutput);
+	else
+		printf("cannot read tree\n");
 	fclose(treeinput);
 	fclose(treeoutput);
-	readvalb(val, valoutput, TRAIN_N);
-	fprinttrain(val, valinput);
+	val=readvalf(valoutput, &num);
+	fprinttrain(val, valinput, num);
+	free(val);
 	fclose(valinput);
 	fclose(valoutput);
 	return 0;
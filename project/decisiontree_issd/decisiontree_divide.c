@@ -333,25 +333,31 @@ void compareinfo(value* val, dicisiontree* tree, float* info){
 	node->flag[sel]=1;
 }
 
+// stable counting sort of the node's rows on the split attribute. the sort
+// runs on row indices and every record is moved once by the final gather,
+// which the val file handed to the next stage needs.
 void dividesection(value* val, dicisiontree* tree){
 	treenode* node=&tree->node[tree->num];
-	value vallist[TRAIN_N][MAX_ATTR_VAL];
-	int i, j, k;
+	static int rowidx[TRAIN_N];
+	static value sorted[TRAIN_N];
+	int pos[MAX_ATTR_VAL];
+	int i, j;
 
+	for(i=node->startnum;i<node->startnum+node->num;i++){
+		node->listcount[val[i].attr[node->attnum]]++;
+	}
+	pos[0]=0;
+	for(j=1;j<MAX_ATTR_VAL;j++){
+		pos[j]=pos[j-1]+node->listcount[j-1];
+	}
 	for(i=node->startnum;i<node->startnum+node->num;i++){
 		j=val[i].attr[node->attnum];
-		vallist[node->listcount[j]][j]=val[i];
-		node->listcount[j]++;
+		rowidx[pos[j]++]=i;
 	}
-	i=node->startnum;
-	while(i<node->startnum+node->num){
-		for(j=0;j<MAX_ATTR_VAL;j++){
-			for(k=0;k<node->listcount[j];k++){
-				val[i]=vallist[k][j];
-				i++;
-			}
-		}
+	for(i=0;i<node->num;i++){
+		sorted[i]=val[rowidx[i]];
 	}
+	memcpy(&val[node->startnum], sorted, sizeof(value)*node->num);
 }
 
 void makesubtree(value* val, dicisiontree* tree){
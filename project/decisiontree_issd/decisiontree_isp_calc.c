@@ -1,7 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <pthread.h>
+#include "s4.h"
 
 #define MAX_ATTR_NUM 19
 #define MAX_ATTR_VAL 33
@@ -12,7 +14,7 @@
 
 #define ATTR_MAX {9,	16,	15,	33,	4,	10,	8,	4,	6,	6,	3,	17,	5,	4,	2,	2,	2,	2,	2}
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 
 typedef struct value{
@@ -39,22 +41,12 @@ typedef struct dicisiontree{
 }dicisiontree;
 
 typedef struct calcinfostruct{
-	float* info;
 	value* val;
-	treenode* node;
 	int snum;
 	int nnum;
-	float (*subptr)[MAX_ATTR_VAL];
+	int (*hist)[MAX_ATTR_VAL][MAX_INFO_VAL];
 }calcinfostruct;
 
-typedef struct checkleafnodestruct{
-	int* res;
-	value* val;
-	int firstnum;
-	int startnum;
-	int num;
-}checkleafnodestruct;
-
 typedef struct teststruct{
 	value* val;
 	int startnum;
@@ -65,6 +57,9 @@ typedef struct teststruct{
 
 
 int subnum[MAX_ATTR_NUM]=ATTR_MAX;
+// log2(n) and n*log2(n) for every possible row count, filled by initlog2table
+double log2n[TRAIN_N+1];
+double nlog2n[TRAIN_N+1];
 void readsubinfo(float dest[][MAX_ATTR_VAL], FILE* fp){
 	fread(dest, MAX_ATTR_VAL*MAX_ATTR_NUM, sizeof(float), fp);
 }
@@ -116,6 +111,24 @@ void readvalb(value* dest, FILE* fp, int num){
 	fread(dest, num, sizeof(value), fp);
 }
 
+// convert writes val and testval with the rows of any dataset, these stages are
+// built for TRAIN_N and TEST_N of them. stop on any other count, the flat
+// pipeline (issd_wholetree) takes the row count from its file header.
+void checkrows(FILE* fp, const char* name, int num){
+	long size;
+	if(fp==NULL){
+		printf("can not open %s\n", name);
+		exit(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	size=ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if(size!=(long)num*(long)sizeof(value)){
+		printf("%s has %ld rows, the per-stage kernels are built for %d, run with issd_wholetree\n", name, size/(long)sizeof(value), num);
+		exit(1);
+	}
+}
+
 void readinfob(float* info, FILE* fp, int num){
 	fread(info, num, sizeof(float), fp);
 }
@@ -150,182 +163,137 @@ void savetree(dicisiontree* dest, FILE* fp){
 
 
 
-void* checkleafnodefunc(void* thearg){
-	checkleafnodestruct* arg=(checkleafnodestruct*) thearg;
-	int* res=arg->res;
-	value* val=arg->val;
-	int firstnum=arg->firstnum;
-	int startnum=arg->startnum;
-	int num=arg->num;
-	int rres=0;
-	int i;
-	for(i=startnum;i<startnum+num;i++){
-		if(rres==0){
-			if(val[firstnum].res!=val[i].res){
-				rres=1;
-				break;
-			}
-		}
-	}
-
-	*res=rres;
-}
-
+// the check stage folded into calc : takes the next node of the queue and
+// tells if it is a leaf. a node is pure when its info from the parent
+// histogram is 0, so no rows are scanned.
 int checkleafnode(value* val, dicisiontree* tree){
 	treenode* node=&tree->node[++tree->num];
-	int i;
-
-	int res[GEM5_NUMPROCS];
-	int rres=0;
 
-	int rest=node->num%(GEM5_NUMPROCS-1);
-	int snum=node->startnum;
-	pthread_t thread[GEM5_NUMPROCS];
-	checkleafnodestruct structs[GEM5_NUMPROCS];
-	
 	if(node->num==0)
 		return 0;
-	else{
-		if(node->num<GEM5_NUMPROCS){
-			for(i=0;i<node->num;i++){
-				structs[i].res=&res[i];
-				structs[i].val=val;
-				structs[i].firstnum=node->startnum;
-				structs[i].startnum=snum;
-				structs[i].num=1;
-				snum++;
-				pthread_create(&thread[i], NULL, checkleafnodefunc, (void*)&structs[i]);
-			}
-			for(i=0;i<node->num;i++){
-				pthread_join(thread[i], NULL);
-			}
-			for(i=0;i<node->num;i++){
-				if(rres==0){
-					rres=res[i];
-				}
-			}
-		}
-		else{
-			for(i=0;i<GEM5_NUMPROCS;i++){structs[i].res=&res[i];
-				structs[i].val=val;
-				structs[i].firstnum=node->startnum;
-				structs[i].startnum=snum;
-				if(rest==0){
-					structs[i].num=node->num/(GEM5_NUMPROCS-1);
-				}
-				else{
-					structs[i].num=node->num/(GEM5_NUMPROCS-1)+1;
-					rest--;
-				}
-				snum+=structs[i].num;
-				pthread_create(&thread[i], NULL, checkleafnodefunc, (void*)&structs[i]);
-			}
-			for(i=0;i<GEM5_NUMPROCS;i++){
-				pthread_join(thread[i], NULL);
-			}
-			for(i=0;i<GEM5_NUMPROCS;i++){
-				if(rres==0){
-					rres=res[i];
-				}
-			}
-		}
-		if(rres==0)
-			node->treeval=val[node->startnum].res;
+	else if(node->info==0.0f){
+		node->treeval=val[node->startnum].res;
+		return 0;
+	}
+	else return 1;
+}
+
+void initlog2table(){
+	int n;
+	log2n[0]=0.0;
+	nlog2n[0]=0.0;
+	for(n=1;n<=TRAIN_N;n++){
+		log2n[n]=log((double)n)/log(2.0);
+		nlog2n[n]=(double)n*log2n[n];
 	}
-	return rres;
 }
 
+// one scan of the thread's rows fills the (attribute x value x class)
+// counts of every attribute at once
 void* calcinfofunc(void* thearg){
 	calcinfostruct* arg=(calcinfostruct*)thearg;
-	float* dest=arg->info;
+	int (*hist)[MAX_ATTR_VAL][MAX_INFO_VAL]=arg->hist;
 	value* val=arg->val;
-	treenode* node=arg->node;
 	int snum=arg->snum;
 	int num=arg->nnum;
-	int i, j, k;
-	int n;
-	int attnum[MAX_ATTR_NUM][MAX_ATTR_VAL]={0,};
-	int attnumval[MAX_ATTR_NUM][MAX_ATTR_VAL][MAX_INFO_VAL]={0,};
-	float sum, psum, p, fnum, anum, tp;
+	int i, j;
 	value* pval;
-	float (*subptr)[MAX_ATTR_VAL]=arg->subptr;
 
+	memset(hist, 0, sizeof(int)*MAX_ATTR_NUM*MAX_ATTR_VAL*MAX_INFO_VAL);
 	for(i=snum;i<snum+num;i++){
-
-		for(j=node->startnum;j<node->startnum+node->num;j++){
-		pval=&val[j];
-			attnumval[i][pval->attr[i]][pval->res]++;
-			attnum[i][pval->attr[i]]++;
+		pval=&val[i];
+		for(j=0;j<MAX_ATTR_NUM;j++){
+			hist[j][pval->attr[j]][pval->res]++;
 		}
+	}
+}
 
-		sum=0.0f;
-		fnum=(float)node->num;
+// with a = rows having value j and n = rows of class k among them,
+// a*H(j) = a*log2(a) - sum_k n*log2(n), so info = sum_j a*H(j) / num
+void calcinfohist(float subinfo[][MAX_ATTR_VAL], int hist[][MAX_ATTR_VAL][MAX_INFO_VAL], int num, float* info){
+	int i, j, k;
+	int n, a;
+	double sum;
+
+	for(i=0;i<MAX_ATTR_NUM;i++){
+		sum=0.0;
 		for(j=0;j<MAX_ATTR_VAL;j++){
-			psum=0.0f;
-			anum=(float)attnum[i][j];
+			a=0;
 			for(k=0;k<MAX_INFO_VAL;k++){
-				n=attnumval[i][j][k];
-				if(n!=0&&n!=attnum[i][j]){
-					p=(float)n/anum;
-					tp=(log(p)/log(2.0f));
-					p=p*tp;
-					psum-=p;
-					subptr[i][j]+=tp;
+				a+=hist[i][j][k];
+			}
+			if(a==0)
+				continue;
+			sum+=nlog2n[a];
+			for(k=0;k<MAX_INFO_VAL;k++){
+				n=hist[i][j][k];
+				if(n!=0){
+					sum-=nlog2n[n];
+					if(n!=a)
+						subinfo[i][j]+=(float)(log2n[n]-log2n[a]);
 				}
 			}
-			sum+=psum*anum/fnum;
 		}
-		dest[i]=sum;
+		info[i]=(float)(sum/(double)num);
 	}
 }
 
 void calcinfo(float subinfo[][MAX_ATTR_VAL], value* val, dicisiontree* tree, float* info){
-	int i;
-	int snum=0;
-	int nnum;
+	int i, j, k, l;
 	treenode* node=&tree->node[tree->num];
+	int snum=node->startnum;
+	int nthread;
 
-	int rest=MAX_ATTR_NUM%(GEM5_NUMPROCS-1);
-	pthread_t thread[GEM5_NUMPROCS];
-	calcinfostruct structs[GEM5_NUMPROCS];
+	int rest=node->num%(GEM5_NUMPROCS-1);
+	pthread_t thread[S4_MAX_NUMPROCS];
+	calcinfostruct structs[S4_MAX_NUMPROCS];
+	static int hist[S4_MAX_NUMPROCS][MAX_ATTR_NUM][MAX_ATTR_VAL][MAX_INFO_VAL];
 
-	
-	if(MAX_ATTR_NUM<GEM5_NUMPROCS){
-			for(i=0;i<MAX_ATTR_NUM;i++){
-				structs[i].info=info;
-				structs[i].val=val;
-				structs[i].node=node;
-				structs[i].snum=snum;
-				structs[i].nnum=1;
-				structs[i].subptr=subinfo;
-				pthread_create(&thread[i], NULL, calcinfofunc, (void*)&structs[i]);
-				snum++;
+	if(node->num<GEM5_NUMPROCS){
+		nthread=node->num;
+		for(i=0;i<node->num && i<S4_MAX_NUMPROCS;i++){
+			structs[i].val=val;
+			structs[i].snum=snum;
+			structs[i].nnum=1;
+			structs[i].hist=hist[i];
+			pthread_create(&thread[i], NULL, calcinfofunc, (void*)&structs[i]);
+			snum++;
+		}
+	}
+	else{
+		nthread=GEM5_NUMPROCS-1;
+		for(i=0;i<GEM5_NUMPROCS-1;i++){
+			structs[i].val=val;
+			structs[i].snum=snum;
+			structs[i].hist=hist[i];
+			if(rest==0){
+				structs[i].nnum=node->num/(GEM5_NUMPROCS-1);
 			}
-			for(i=0;i<MAX_ATTR_NUM;i++){
-				pthread_join(thread[i], NULL);
+			else{
+				structs[i].nnum=node->num/(GEM5_NUMPROCS-1)+1;
+				rest--;
 			}
+			pthread_create(&thread[i], NULL, calcinfofunc, (void*)&structs[i]);
+			snum+=structs[i].nnum;
 		}
-		else{
-			for(i=0;i<GEM5_NUMPROCS-1;i++){
-				structs[i].info=info;
-				structs[i].val=val;
-				structs[i].node=node;
-				structs[i].snum=snum;
-				structs[i].subptr=subinfo;
-				if(rest==0){
-					structs[i].nnum=MAX_ATTR_NUM/(GEM5_NUMPROCS-1);
-				}
-				else{
-					structs[i].nnum=MAX_ATTR_NUM/(GEM5_NUMPROCS-1)+1;
-					rest--;
+	}
+	for(i=0;i<nthread;i++){
+		pthread_join(thread[i], NULL);
+	}
+
+	// merge the per-thread counts into the first histogram
+	for(l=1;l<nthread;l++){
+		for(i=0;i<MAX_ATTR_NUM;i++){
+			for(j=0;j<MAX_ATTR_VAL;j++){
+				for(k=0;k<MAX_INFO_VAL;k++){
+					hist[0][i][j][k]+=hist[l][i][j][k];
 				}
-				pthread_create(&thread[i], NULL, calcinfofunc, (void*)&structs[i]);
-				snum+=structs[i].nnum;
-			}
-			for(i=0;i<GEM5_NUMPROCS-1;i++){
-				pthread_join(thread[i], NULL);
 			}
 		}
+	}
+	if(nthread==0)
+		memset(hist[0], 0, sizeof(hist[0]));
+	calcinfohist(subinfo, hist[0], node->num, info);
 }
 
 void compareinfo(value* val, dicisiontree* tree, float* info){
@@ -419,10 +387,10 @@ void test(value* val, dicisiontree* tree){
 
 	int rest=TEST_N%(GEM5_NUMPROCS-1);
 	int count=0;
-	pthread_t thread[GEM5_NUMPROCS];
-	teststruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	teststruct structs[S4_MAX_NUMPROCS];
 	if(TEST_N<GEM5_NUMPROCS){
-		for(i=0;i<TEST_N;i++){
+		for(i=0;i<TEST_N && i<S4_MAX_NUMPROCS;i++){
 			structs[i].val=val;
 			structs[i].startnum=count;
 			structs[i].num=1;
@@ -430,7 +398,7 @@ void test(value* val, dicisiontree* tree){
 			count++;
 			pthread_create(&thread[i], NULL, testfunc, (void*)&structs[i]);
 		}
-		for(i=0;i<TEST_N;i++){
+		for(i=0;i<TEST_N && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
@@ -474,16 +442,23 @@ int main(){
 	float subinfo[MAX_ATTR_NUM][MAX_ATTR_VAL]={0,};
 	
 	readtree(&tree, ftree);
+	checkrows(fval, "val", TRAIN_N);
 	readvalb(val, fval, TRAIN_N);
-	calcinfo(subinfo, val, &tree, info);
-	
-	saveinfob(info, finfo, MAX_ATTR_NUM);
-	
-	savesubinfo(subinfo, fsubinfo);
+	fclose(ftree);
+	fclose(fval);
+	if(checkleafnode(val, &tree)){
+		initlog2table();
+		calcinfo(subinfo, val, &tree, info);
+		
+		saveinfob(info, finfo, MAX_ATTR_NUM);
+		
+		savesubinfo(subinfo, fsubinfo);
+	}
+	ftree=fopen("tree", "wb");
+	savetree(&tree, ftree);
 	
 	fclose(fsubinfo);
 	fclose(ftree);
-	fclose(fval);
 	fclose(finfo);
 	return 0;
 }
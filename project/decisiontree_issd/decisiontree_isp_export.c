@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "s4.h"
+
+#define MAX_ATTR_NUM 19
+#define MAX_ATTR_VAL 33
+#define MAX_INFO_VAL 10
+#define TRAIN_N 700
+
+#define GEM5_NUMPROCS s4_numprocs()
+
+
+typedef struct treenode{
+	float info;
+	int treeval;//
+	int startnum;//
+	int num;//
+	int subnum;
+	int subptr[MAX_ATTR_VAL];//
+	int listcount[MAX_ATTR_VAL];
+	int attnum;//
+	int flag[MAX_ATTR_NUM];
+}treenode;
+
+typedef struct dicisiontree{
+	int num;
+	int maxnum;
+	struct treenode* node;
+}dicisiontree;
+
+// inference model : the children of a split are contiguous, the child
+// for attribute value v is child+v. leaves have attr -1.
+typedef struct flatnode{
+	int attr;
+	int child;
+	int leaf;
+}flatnode;
+
+
+
+// tree file : num and maxnum, then at least maxnum nodes. train writes the
+// maxnum it made, the per-stage kernels their whole table. -1 if it is short.
+int readtree(dicisiontree* dest, FILE* fp){
+	if(fp==NULL||fread(&dest->num, sizeof(int), 1, fp)!=1||fread(&dest->maxnum, sizeof(int), 1, fp)!=1||dest->maxnum<=0)
+		return -1;
+	dest->node=malloc(sizeof(treenode)*dest->maxnum);
+	if(dest->node==NULL||fread(dest->node, sizeof(treenode), dest->maxnum, fp)!=dest->maxnum)
+		return -1;
+	return 0;
+}
+void saveflat(flatnode* flat, int num, FILE* fp){
+	fwrite(&num, 1, sizeof(int), fp);
+	fwrite(flat, num, sizeof(flatnode), fp);
+}
+
+// keeps the node numbering of the tree. makesubtree appends all children of
+// a split at once, so subptr[0] is the base of a contiguous block. a node
+// is a leaf when it got a class or has no rows, like testfunc treats it.
+int exporttree(flatnode* flat, dicisiontree* tree){
+	treenode* node;
+	int i, j;
+
+	for(i=0;i<tree->maxnum;i++){
+		node=&tree->node[i];
+		if(node->treeval>=0||node->num==0){
+			flat[i].attr=-1;
+			flat[i].child=-1;
+			flat[i].leaf=node->treeval;
+		}
+		else{
+			for(j=1;j<node->subnum;j++){
+				if(node->subptr[j]!=node->subptr[0]+j)
+					return -1;
+			}
+			flat[i].attr=node->attnum;
+			flat[i].child=node->subptr[0];
+			flat[i].leaf=-1;
+		}
+	}
+	return tree->maxnum;
+}
+
+int main(){
+	static dicisiontree tree;
+	flatnode* flat;
+	FILE* ftree=fopen("tree", "rb");
+	FILE* fflat;
+	int num;
+
+	if(readtree(&tree, ftree)<0){
+		printf("cannot read tree\n");
+		return 1;
+	}
+	fclose(ftree);
+
+	flat=malloc(sizeof(flatnode)*tree.maxnum);
+	num=exporttree(flat, &tree);
+	if(num<0){
+		printf("children of a node are not contiguous\n");
+		return 1;
+	}
+	fflat=fopen("treeflat", "wb");
+	saveflat(flat, num, fflat);
+	fclose(fflat);
+	printf("exported %d nodes, %d bytes\n", num, (int)(sizeof(int)+num*sizeof(flatnode)));
+	return 0;
+}
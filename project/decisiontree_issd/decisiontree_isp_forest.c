@@ -0,0 +1,587 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "s4.h"
+#include <sys/time.h>
+
+#define MAX_ATTR_NUM 19
+#define MAX_ATTR_VAL 33
+#define MAX_INFO_VAL 10
+#define TEST_BLOCK 64
+
+#define FOREST_TREES 16
+#define FOREST_SEED 1
+#define FOREST_MIN_SPLIT 2
+
+#define GEM5_NUMPROCS s4_numprocs()
+
+
+typedef struct value{
+	int attr[MAX_ATTR_NUM];
+	int res;
+}value;
+
+// dataset file : rows, attrs, classes and card[attrs] ints, then attrs
+// columns of rows unsigned chars and the class column
+typedef struct dataset{
+	int rows;
+	int attrs;
+	int classes;
+	int card[MAX_ATTR_NUM];
+	unsigned char* col[MAX_ATTR_NUM];
+	unsigned char* res;
+}dataset;
+
+// inference model : the children of a split are contiguous, the child
+// for attribute value v is child+v. leaves have attr -1.
+typedef struct flatnode{
+	int attr;
+	int child;
+	int leaf;
+}flatnode;
+
+// training state of a node, rows [startnum, startnum+num) of the tree's
+// bootstrap sample. used is a bitmask of the attributes on the path.
+typedef struct forestnode{
+	int startnum;
+	int num;
+	int used;
+	int parentclass;
+}forestnode;
+
+typedef struct foresttree{
+	int num;
+	int maxnum;
+	flatnode* node;
+	forestnode* work;
+}foresttree;
+
+// tree ids of a worker. the owner pops from the tail, idle workers steal
+// from the head.
+typedef struct treequeue{
+	pthread_mutex_t lock;
+	int head;
+	int tail;
+	int* tree;
+}treequeue;
+
+typedef struct foreststruct{
+	int id;
+	int nworker;
+	dataset* set;
+	foresttree* trees;
+	treequeue* queue;
+	int done;
+	int stolen;
+}foreststruct;
+
+typedef struct predictstruct{
+	dataset* set;
+	foresttree* trees;
+	int startnum;
+	int num;
+	int* out;
+}predictstruct;
+
+
+
+int ntrees=FOREST_TREES;
+int nsubattr=0;
+unsigned int seed=FOREST_SEED;
+// log2(n) and n*log2(n) for every possible row count, filled by initlog2table
+double* log2n;
+double* nlog2n;
+
+// reads a dataset file written by convert, -1 if it does not fit the
+// MAX_ capacities
+int readset(dataset* set, FILE* fp){
+	int j;
+
+	fread(&set->rows, 1, sizeof(int), fp);
+	fread(&set->attrs, 1, sizeof(int), fp);
+	fread(&set->classes, 1, sizeof(int), fp);
+	if(set->rows<=0||set->attrs<=0||set->attrs>MAX_ATTR_NUM||set->classes>MAX_INFO_VAL)
+		return -1;
+	fread(set->card, set->attrs, sizeof(int), fp);
+	for(j=0;j<set->attrs;j++){
+		if(set->card[j]>MAX_ATTR_VAL)
+			return -1;
+	}
+	for(j=0;j<set->attrs;j++){
+		set->col[j]=malloc(set->rows);
+		fread(set->col[j], 1, set->rows, fp);
+	}
+	set->res=malloc(set->rows);
+	fread(set->res, 1, set->rows, fp);
+	return 0;
+}
+void savevalb(value* dest, FILE* fp, int num){
+	fwrite(dest, num, sizeof(value), fp);
+}
+void saveforest(foresttree* trees, FILE* fp){
+	int t;
+
+	fwrite(&ntrees, 1, sizeof(int), fp);
+	for(t=0;t<ntrees;t++){
+		fwrite(&trees[t].num, 1, sizeof(int), fp);
+		fwrite(trees[t].node, trees[t].num, sizeof(flatnode), fp);
+	}
+}
+
+void initlog2table(int rows){
+	int n;
+	log2n=malloc(sizeof(double)*(rows+1));
+	nlog2n=malloc(sizeof(double)*(rows+1));
+	log2n[0]=0.0;
+	nlog2n[0]=0.0;
+	for(n=1;n<=rows;n++){
+		log2n[n]=log((double)n)/log(2.0);
+		nlog2n[n]=(double)n*log2n[n];
+	}
+}
+
+// xorshift, one stream per tree so a tree does not depend on the worker
+// that trains it
+unsigned int nextrand(unsigned int* state){
+	unsigned int x=*state;
+	x^=x<<13;
+	x^=x>>17;
+	x^=x<<5;
+	*state=x;
+	return x;
+}
+
+// with a = rows having value j and n = rows of class k among them,
+// a*H(j) = a*log2(a) - sum_k n*log2(n), so info = sum_j a*H(j) / num.
+// attributes with flag set are not counted and keep info 0.
+void calcinfohist(float subinfo[][MAX_ATTR_VAL], int hist[][MAX_ATTR_VAL][MAX_INFO_VAL], dataset* set, int* flag, int num, float* info){
+	int i, j, k;
+	int n, a;
+	double sum;
+
+	for(i=0;i<set->attrs;i++){
+		if(flag[i])
+			continue;
+		sum=0.0;
+		for(j=0;j<set->card[i];j++){
+			a=0;
+			for(k=0;k<set->classes;k++){
+				a+=hist[i][j][k];
+			}
+			if(a==0)
+				continue;
+			sum+=nlog2n[a];
+			for(k=0;k<set->classes;k++){
+				n=hist[i][j][k];
+				if(n!=0){
+					sum-=nlog2n[n];
+					if(n!=a)
+						subinfo[i][j]+=(float)(log2n[n]-log2n[a]);
+				}
+			}
+		}
+		info[i]=(float)(sum/(double)num);
+	}
+}
+
+// returns the candidate attribute with the lowest info, -1 if there is none
+int compareinfo(int* flag, float* info, int attrs){
+	int i;
+	int sel=-1;
+	float self=0xFFFFFFFF;
+
+	for(i=0;i<attrs;i++){
+		if(flag[i]==0){
+			if(self>info[i]){
+				sel=i;
+				self=info[i];
+			}
+		}
+	}
+	return sel;
+}
+
+int addnode(foresttree* tree, int startnum, int num, int used, int parentclass){
+	if(tree->num==tree->maxnum){
+		tree->maxnum*=2;
+		tree->node=realloc(tree->node, sizeof(flatnode)*tree->maxnum);
+		tree->work=realloc(tree->work, sizeof(forestnode)*tree->maxnum);
+	}
+	tree->work[tree->num].startnum=startnum;
+	tree->work[tree->num].num=num;
+	tree->work[tree->num].used=used;
+	tree->work[tree->num].parentclass=parentclass;
+	return tree->num++;
+}
+
+// grows tree t on a bootstrap sample of the training rows, breadth first
+// like decisiontree_isp_train. every split only looks at nsubattr random
+// attributes not yet used on the path. rowidx, rowtmp and hist belong to
+// the worker.
+void growtree(dataset* set, foresttree* tree, int t, int* rowidx, int* rowtmp, int hist[][MAX_ATTR_VAL][MAX_INFO_VAL]){
+	unsigned int state=seed*2654435761u+(unsigned int)t*40503u+1u;
+	float info[MAX_ATTR_NUM];
+	float subinfo[MAX_ATTR_NUM][MAX_ATTR_VAL];
+	int flag[MAX_ATTR_NUM];
+	int cand[MAX_ATTR_NUM];
+	int classcount[MAX_INFO_VAL];
+	int pos[MAX_ATTR_VAL];
+	int i, j, k, n, r;
+	int ncand, major, sel, child;
+	int* idx;
+	unsigned char* col;
+	forestnode* fn;
+	flatnode* out;
+
+	for(i=0;i<set->rows;i++){
+		rowidx[i]=nextrand(&state)%set->rows;
+	}
+	tree->num=0;
+	tree->maxnum=64;
+	tree->node=malloc(sizeof(flatnode)*tree->maxnum);
+	tree->work=malloc(sizeof(forestnode)*tree->maxnum);
+	addnode(tree, 0, set->rows, 0, 0);
+
+	for(n=0;n<tree->num;n++){
+		fn=&tree->work[n];
+		out=&tree->node[n];
+		out->attr=-1;
+		out->child=-1;
+		out->leaf=fn->parentclass;
+		if(fn->num==0)
+			continue;
+		idx=&rowidx[fn->startnum];
+
+		memset(classcount, 0, sizeof(classcount));
+		for(i=0;i<fn->num;i++){
+			classcount[set->res[idx[i]]]++;
+		}
+		major=0;
+		for(k=1;k<set->classes;k++){
+			if(classcount[k]>classcount[major])
+				major=k;
+		}
+		out->leaf=major;
+		if(classcount[major]==fn->num||fn->num<FOREST_MIN_SPLIT)
+			continue;
+
+		ncand=0;
+		for(j=0;j<set->attrs;j++){
+			flag[j]=1;
+			if((fn->used&(1<<j))==0)
+				cand[ncand++]=j;
+		}
+		for(i=0;i<nsubattr&&i<ncand;i++){
+			r=i+nextrand(&state)%(ncand-i);
+			j=cand[r];
+			cand[r]=cand[i];
+			cand[i]=j;
+			flag[j]=0;
+		}
+		if(ncand==0)
+			continue;
+
+		for(i=0;i<nsubattr&&i<ncand;i++){
+			j=cand[i];
+			col=set->col[j];
+			memset(hist[j], 0, sizeof(int)*MAX_ATTR_VAL*MAX_INFO_VAL);
+			for(r=0;r<fn->num;r++){
+				hist[j][col[idx[r]]][set->res[idx[r]]]++;
+			}
+		}
+		memset(info, 0, sizeof(info));
+		memset(subinfo, 0, sizeof(subinfo));
+		calcinfohist(subinfo, hist, set, flag, fn->num, info);
+		sel=compareinfo(flag, info, set->attrs);
+
+		// stable counting sort of the node's rows on the split attribute
+		col=set->col[sel];
+		memset(pos, 0, sizeof(pos));
+		for(i=0;i<fn->num;i++){
+			pos[col[idx[i]]]++;
+		}
+		child=tree->num;
+		r=0;
+		for(j=0;j<set->card[sel];j++){
+			k=pos[j];
+			addnode(tree, tree->work[n].startnum+r, k, tree->work[n].used|(1<<sel), major);
+			pos[j]=r;
+			r+=k;
+		}
+		fn=&tree->work[n];
+		out=&tree->node[n];
+		for(i=0;i<fn->num;i++){
+			rowtmp[pos[col[idx[i]]]++]=idx[i];
+		}
+		memcpy(idx, rowtmp, sizeof(int)*fn->num);
+		out->attr=sel;
+		out->child=child;
+	}
+	free(tree->work);
+	tree->work=NULL;
+}
+
+int poptree(treequeue* q){
+	int t=-1;
+
+	pthread_mutex_lock(&q->lock);
+	if(q->tail>q->head)
+		t=q->tree[--q->tail];
+	pthread_mutex_unlock(&q->lock);
+	return t;
+}
+
+int stealtree(treequeue* q){
+	int t=-1;
+
+	pthread_mutex_lock(&q->lock);
+	if(q->tail>q->head)
+		t=q->tree[q->head++];
+	pthread_mutex_unlock(&q->lock);
+	return t;
+}
+
+// trains the trees of its own queue, then steals from the other workers.
+// no tree is ever added, so when every queue is empty the work is done.
+void* forestfunc(void* thearg){
+	foreststruct* arg=(foreststruct*)thearg;
+	dataset* set=arg->set;
+	int* rowidx=malloc(sizeof(int)*set->rows);
+	int* rowtmp=malloc(sizeof(int)*set->rows);
+	int (*hist)[MAX_ATTR_VAL][MAX_INFO_VAL]=malloc(sizeof(int)*MAX_ATTR_NUM*MAX_ATTR_VAL*MAX_INFO_VAL);
+	int t, k;
+
+	arg->done=0;
+	arg->stolen=0;
+	while(1){
+		t=poptree(&arg->queue[arg->id]);
+		for(k=1;t<0&&k<arg->nworker;k++){
+			t=stealtree(&arg->queue[(arg->id+k)%arg->nworker]);
+			if(t>=0)
+				arg->stolen++;
+		}
+		if(t<0)
+			break;
+		growtree(set, &arg->trees[t], t, rowidx, rowtmp, hist);
+		arg->done++;
+	}
+	free(rowidx);
+	free(rowtmp);
+	free(hist);
+}
+
+void forest(dataset* set, foresttree* trees){
+	int i, t;
+	int snum=0;
+	int nthread;
+
+	int rest;
+	pthread_t thread[S4_MAX_NUMPROCS];
+	foreststruct structs[S4_MAX_NUMPROCS];
+	treequeue queue[S4_MAX_NUMPROCS];
+
+	nthread=(ntrees<GEM5_NUMPROCS)?ntrees:GEM5_NUMPROCS-1;
+	rest=ntrees%nthread;
+	for(i=0;i<nthread;i++){
+		pthread_mutex_init(&queue[i].lock, NULL);
+		queue[i].tree=malloc(sizeof(int)*ntrees);
+		queue[i].head=0;
+		queue[i].tail=0;
+		if(ntrees<GEM5_NUMPROCS)
+			queue[i].tree[queue[i].tail++]=snum++;
+		else{
+			for(t=0;t<ntrees/nthread+(i<rest);t++)
+				queue[i].tree[queue[i].tail++]=snum++;
+		}
+	}
+	for(i=0;i<nthread;i++){
+		structs[i].id=i;
+		structs[i].nworker=nthread;
+		structs[i].set=set;
+		structs[i].trees=trees;
+		structs[i].queue=queue;
+		pthread_create(&thread[i], NULL, forestfunc, (void*)&structs[i]);
+	}
+	for(i=0;i<nthread;i++){
+		pthread_join(thread[i], NULL);
+	}
+	for(i=0;i<nthread;i++){
+		printf("worker %d trained %d trees, %d stolen\n", i, structs[i].done, structs[i].stolen);
+		free(queue[i].tree);
+	}
+}
+
+// a block of rows goes down every tree one level per pass, the votes of
+// all trees are summed before the block is left
+void* predictfunc(void* thearg){
+	predictstruct* arg=(predictstruct*)thearg;
+	dataset* set=arg->set;
+	int end=arg->startnum+arg->num;
+	int cur[TEST_BLOCK];
+	int vote[TEST_BLOCK][MAX_INFO_VAL];
+	int i, b, n, t, k;
+	int active;
+	flatnode* flat;
+	flatnode* fnode;
+
+	for(b=arg->startnum;b<end;b+=TEST_BLOCK){
+		n=(end-b<TEST_BLOCK)?end-b:TEST_BLOCK;
+		memset(vote, 0, sizeof(vote));
+		for(t=0;t<ntrees;t++){
+			flat=arg->trees[t].node;
+			for(i=0;i<n;i++){
+				cur[i]=0;
+			}
+			active=n;
+			while(active>0){
+				active=0;
+				for(i=0;i<n;i++){
+					fnode=&flat[cur[i]];
+					if(fnode->attr<0)
+						continue;
+					cur[i]=fnode->child+set->col[fnode->attr][b+i];
+					active++;
+				}
+			}
+			for(i=0;i<n;i++){
+				vote[i][flat[cur[i]].leaf]++;
+			}
+		}
+		for(i=0;i<n;i++){
+			arg->out[b+i]=0;
+			for(k=1;k<set->classes;k++){
+				if(vote[i][k]>vote[i][arg->out[b+i]])
+					arg->out[b+i]=k;
+			}
+		}
+	}
+}
+
+void predict(dataset* set, foresttree* trees, int* out){
+	int i;
+
+	int rest=set->rows%(GEM5_NUMPROCS-1);
+	int count=0;
+	int nthread;
+	pthread_t thread[S4_MAX_NUMPROCS];
+	predictstruct structs[S4_MAX_NUMPROCS];
+	if(set->rows<GEM5_NUMPROCS){
+		nthread=set->rows;
+		for(i=0;i<set->rows && i<S4_MAX_NUMPROCS;i++){
+			structs[i].set=set;
+			structs[i].trees=trees;
+			structs[i].out=out;
+			structs[i].startnum=count;
+			structs[i].num=1;
+			count++;
+			pthread_create(&thread[i], NULL, predictfunc, (void*)&structs[i]);
+		}
+	}
+	else{
+		nthread=GEM5_NUMPROCS-1;
+		for(i=0;i<GEM5_NUMPROCS-1;i++){
+			structs[i].set=set;
+			structs[i].trees=trees;
+			structs[i].out=out;
+			structs[i].startnum=count;
+			if(rest==0){
+				structs[i].num=set->rows/(GEM5_NUMPROCS-1);
+			}
+			else{
+				structs[i].num=set->rows/(GEM5_NUMPROCS-1)+1;
+				rest--;
+			}
+			count+=structs[i].num;
+			pthread_create(&thread[i], NULL, predictfunc, (void*)&structs[i]);
+		}
+	}
+	for(i=0;i<nthread;i++){
+		pthread_join(thread[i], NULL);
+	}
+}
+
+double elapsed(struct timeval* start){
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec-start->tv_sec)+(now.tv_usec-start->tv_usec)/1000000.0;
+}
+
+// argv : number of trees, attributes tried per split (0 : sqrt of the
+// attribute count), random seed
+int main(int argc, char* argv[]){
+	static dataset set;
+	static dataset test;
+	foresttree* trees;
+	value* val;
+	int* out;
+	FILE* fp;
+	struct timeval start;
+	double sec;
+	int i, j, t;
+	long nodes=0;
+	long correct=0;
+
+	if(argc>1)
+		ntrees=atoi(argv[1]);
+	if(argc>2)
+		nsubattr=atoi(argv[2]);
+	if(argc>3)
+		seed=atoi(argv[3]);
+
+	fp=fopen("trainset", "rb");
+	i=readset(&set, fp);
+	fclose(fp);
+	fp=fopen("testset", "rb");
+	j=readset(&test, fp);
+	fclose(fp);
+	if(i<0||j<0||ntrees<1){
+		printf("trainset or testset does not fit MAX_ATTR_NUM %d, MAX_ATTR_VAL %d, MAX_INFO_VAL %d\n", MAX_ATTR_NUM, MAX_ATTR_VAL, MAX_INFO_VAL);
+		return 1;
+	}
+	if(nsubattr<=0)
+		nsubattr=(int)(sqrt((double)set.attrs)+0.5);
+	initlog2table(set.rows);
+	trees=calloc(ntrees, sizeof(foresttree));
+
+	gettimeofday(&start, NULL);
+	forest(&set, trees);
+	sec=elapsed(&start);
+	for(t=0;t<ntrees;t++)
+		nodes+=trees[t].num;
+	printf("forest %d trees, %d attributes per split, %ld nodes\n", ntrees, nsubattr, nodes);
+	if(sec>0.0)
+		printf("train %.3f s, %.2f trees/sec, %.0f rows/sec\n", sec, ntrees/sec, (double)ntrees*set.rows/sec);
+
+	out=malloc(sizeof(int)*set.rows);
+	predict(&set, trees, out);
+	for(i=0;i<set.rows;i++)
+		correct+=(out[i]==set.res[i]);
+	printf("training set accuracy %.4f\n", (double)correct/set.rows);
+	free(out);
+
+	out=malloc(sizeof(int)*test.rows);
+	gettimeofday(&start, NULL);
+	predict(&test, trees, out);
+	sec=elapsed(&start);
+	if(sec>0.0)
+		printf("predict %.3f s, %.0f rows/sec\n", sec, test.rows/sec);
+
+	val=calloc(test.rows, sizeof(value));
+	for(i=0;i<test.rows;i++){
+		for(j=0;j<test.attrs;j++)
+			val[i].attr[j]=test.col[j][i];
+		val[i].res=out[i];
+	}
+	fp=fopen("testvalo", "wb");
+	savevalb(val, fp, test.rows);
+	fclose(fp);
+	fp=fopen("treeforest", "wb");
+	saveforest(trees, fp);
+	fclose(fp);
+	free(val);
+	free(out);
+	return 0;
+}
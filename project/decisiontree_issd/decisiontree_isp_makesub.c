@@ -1,7 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <pthread.h>
+#include "s4.h"
 
 #define MAX_ATTR_NUM 19
 #define MAX_ATTR_VAL 33
@@ -12,7 +14,7 @@
 
 #define ATTR_MAX {9,	16,	15,	33,	4,	10,	8,	4,	6,	6,	3,	17,	5,	4,	2,	2,	2,	2,	2}
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 
 typedef struct value{
@@ -115,6 +117,24 @@ void readvalb(value* dest, FILE* fp, int num){
 	fread(dest, num, sizeof(value), fp);
 }
 
+// convert writes val and testval with the rows of any dataset, these stages are
+// built for TRAIN_N and TEST_N of them. stop on any other count, the flat
+// pipeline (issd_wholetree) takes the row count from its file header.
+void checkrows(FILE* fp, const char* name, int num){
+	long size;
+	if(fp==NULL){
+		printf("can not open %s\n", name);
+		exit(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	size=ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if(size!=(long)num*(long)sizeof(value)){
+		printf("%s has %ld rows, the per-stage kernels are built for %d, run with issd_wholetree\n", name, size/(long)sizeof(value), num);
+		exit(1);
+	}
+}
+
 void readinfob(float* info, FILE* fp, int num){
 	fread(info, num, sizeof(float), fp);
 }
@@ -174,19 +194,19 @@ int checkleafnode(value* val, dicisiontree* tree){
 	treenode* node=&tree->node[++tree->num];
 	int i;
 
-	int res[GEM5_NUMPROCS];
+	int res[S4_MAX_NUMPROCS];
 	int rres=0;
 
 	int rest=node->num%(GEM5_NUMPROCS-1);
 	int snum=node->startnum;
-	pthread_t thread[GEM5_NUMPROCS];
-	checkleafnodestruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	checkleafnodestruct structs[S4_MAX_NUMPROCS];
 	
 	if(node->num==0)
 		return 0;
 	else{
 		if(node->num<GEM5_NUMPROCS){
-			for(i=0;i<node->num;i++){
+			for(i=0;i<node->num && i<S4_MAX_NUMPROCS;i++){
 				structs[i].res=&res[i];
 				structs[i].val=val;
 				structs[i].firstnum=node->startnum;
@@ -195,10 +215,10 @@ int checkleafnode(value* val, dicisiontree* tree){
 				snum++;
 				pthread_create(&thread[i], NULL, checkleafnodefunc, (void*)&structs[i]);
 			}
-			for(i=0;i<node->num;i++){
+			for(i=0;i<node->num && i<S4_MAX_NUMPROCS;i++){
 				pthread_join(thread[i], NULL);
 			}
-			for(i=0;i<node->num;i++){
+			for(i=0;i<node->num && i<S4_MAX_NUMPROCS;i++){
 				if(rres==0){
 					rres=res[i];
 				}
@@ -282,11 +302,11 @@ void calcinfo(value* val, dicisiontree* tree, float* info){
 	treenode* node=&tree->node[tree->num];
 
 	int rest=MAX_ATTR_NUM%(GEM5_NUMPROCS-1);
-	pthread_t thread[GEM5_NUMPROCS];
-	calcinfostruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	calcinfostruct structs[S4_MAX_NUMPROCS];
 
 	if(MAX_ATTR_NUM<GEM5_NUMPROCS){
-		for(i=0;i<MAX_ATTR_NUM;i++){
+		for(i=0;i<MAX_ATTR_NUM && i<S4_MAX_NUMPROCS;i++){
 			structs[i].info=info;
 			structs[i].val=val;
 			structs[i].node=node;
@@ -295,7 +315,7 @@ void calcinfo(value* val, dicisiontree* tree, float* info){
 			pthread_create(&thread[i], NULL, calcinfofunc, (void*)&structs[i]);
 			snum++;
 		}
-		for(i=0;i<MAX_ATTR_NUM;i++){
+		for(i=0;i<MAX_ATTR_NUM && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
@@ -413,10 +433,10 @@ void test(value* val, dicisiontree* tree){
 
 	int rest=TEST_N%(GEM5_NUMPROCS-1);
 	int count=0;
-	pthread_t thread[GEM5_NUMPROCS];
-	teststruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	teststruct structs[S4_MAX_NUMPROCS];
 	if(TEST_N<GEM5_NUMPROCS){
-		for(i=0;i<TEST_N;i++){
+		for(i=0;i<TEST_N && i<S4_MAX_NUMPROCS;i++){
 			structs[i].val=val;
 			structs[i].startnum=count;
 			structs[i].num=1;
@@ -424,7 +444,7 @@ void test(value* val, dicisiontree* tree){
 			count++;
 			pthread_create(&thread[i], NULL, testfunc, (void*)&structs[i]);
 		}
-		for(i=0;i<TEST_N;i++){
+		for(i=0;i<TEST_N && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
@@ -469,6 +489,7 @@ int main(){
 	fclose(finfo);
 	
 	readtree(&tree, ftree);
+	checkrows(fval, "val", TRAIN_N);
 	readvalb(val, fval, TRAIN_N);
 
 	makesubtree(subinfo, val, &tree);
@@ -1,18 +1,20 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <pthread.h>
+#include "s4.h"
 
 #define MAX_ATTR_NUM 19
 #define MAX_ATTR_VAL 33
 #define MAX_INFO_VAL 10
 #define TRAIN_N 700
-#define TEST_N 150
+#define TEST_N 8500
 #define MAX_TREE_NUM 2227//500
 
 #define ATTR_MAX {9,	16,	15,	33,	4,	10,	8,	4,	6,	6,	3,	17,	5,	4,	2,	2,	2,	2,	2}
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 
 typedef struct value{
@@ -109,12 +111,39 @@ void readvalb(value* dest, FILE* fp, int num){
 	fread(dest, num, sizeof(value), fp);
 }
 
+// convert writes val and testval with the rows of any dataset, these stages are
+// built for TRAIN_N and TEST_N of them. stop on any other count, the flat
+// pipeline (issd_wholetree) takes the row count from its file header.
+void checkrows(FILE* fp, const char* name, int num){
+	long size;
+	if(fp==NULL){
+		printf("can not open %s\n", name);
+		exit(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	size=ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if(size!=(long)num*(long)sizeof(value)){
+		printf("%s has %ld rows, the per-stage kernels are built for %d, run with issd_wholetree\n", name, size/(long)sizeof(value), num);
+		exit(1);
+	}
+}
+
 void readinfob(float* info, FILE* fp, int num){
 	fread(info, num, sizeof(float), fp);
 }
 
-void readtree(dicisiontree* dest, FILE* fp){
-	fread(dest, 1, sizeof(dicisiontree), fp);
+// tree file : num and maxnum, then at least maxnum nodes. the per-stage kernels
+// write their whole table, train only the maxnum nodes it made, which may be
+// more than this table holds. -1 if the tree is short or does not fit.
+int readtree(dicisiontree* dest, FILE* fp){
+	if(fp==NULL||fread(&dest->num, sizeof(int), 1, fp)!=1||fread(&dest->maxnum, sizeof(int), 1, fp)!=1)
+		return -1;
+	if(dest->maxnum<=0||dest->maxnum>MAX_TREE_NUM)
+		return -1;
+	if(fread(dest->node, sizeof(treenode), dest->maxnum, fp)!=dest->maxnum)
+		return -1;
+	return 0;
 }
 void savevalb(value* dest, FILE* fp, int num){
 	fwrite(dest, num, sizeof(value), fp);
@@ -168,19 +197,19 @@ int checkleafnode(value* val, dicisiontree* tree){
 	treenode* node=&tree->node[++tree->num];
 	int i;
 
-	int res[GEM5_NUMPROCS];
+	int res[S4_MAX_NUMPROCS];
 	int rres=0;
 
 	int rest=node->num%(GEM5_NUMPROCS-1);
 	int snum=node->startnum;
-	pthread_t thread[GEM5_NUMPROCS];
-	checkleafnodestruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	checkleafnodestruct structs[S4_MAX_NUMPROCS];
 	
 	if(node->num==0)
 		return 0;
 	else{
 		if(node->num<GEM5_NUMPROCS){
-			for(i=0;i<node->num;i++){
+			for(i=0;i<node->num && i<S4_MAX_NUMPROCS;i++){
 				structs[i].res=&res[i];
 				structs[i].val=val;
 				structs[i].firstnum=node->startnum;
@@ -189,10 +218,10 @@ int checkleafnode(value* val, dicisiontree* tree){
 				snum++;
 				pthread_create(&thread[i], NULL, checkleafnodefunc, (void*)&structs[i]);
 			}
-			for(i=0;i<node->num;i++){
+			for(i=0;i<node->num && i<S4_MAX_NUMPROCS;i++){
 				pthread_join(thread[i], NULL);
 			}
-			for(i=0;i<node->num;i++){
+			for(i=0;i<node->num && i<S4_MAX_NUMPROCS;i++){
 				if(rres==0){
 					rres=res[i];
 				}
@@ -276,11 +305,11 @@ void calcinfo(value* val, dicisiontree* tree, float* info){
 	treenode* node=&tree->node[tree->num];
 
 	int rest=MAX_ATTR_NUM%(GEM5_NUMPROCS-1);
-	pthread_t thread[GEM5_NUMPROCS];
-	calcinfostruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	calcinfostruct structs[S4_MAX_NUMPROCS];
 
 	if(MAX_ATTR_NUM<GEM5_NUMPROCS){
-		for(i=0;i<MAX_ATTR_NUM;i++){
+		for(i=0;i<MAX_ATTR_NUM && i<S4_MAX_NUMPROCS;i++){
 			structs[i].info=info;
 			structs[i].val=val;
 			structs[i].node=node;
@@ -289,7 +318,7 @@ void calcinfo(value* val, dicisiontree* tree, float* info){
 			pthread_create(&thread[i], NULL, calcinfofunc, (void*)&structs[i]);
 			snum++;
 		}
-		for(i=0;i<MAX_ATTR_NUM;i++){
+		for(i=0;i<MAX_ATTR_NUM && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
@@ -411,13 +440,17 @@ void test(value* val, dicisiontree* tree){
 
 
 int main(){
-	value val[TEST_N];
+	static value val[TEST_N];
 	FILE* ftree=fopen("tree", "rb");
 	FILE* fval=fopen("testval", "rb");
 	FILE* fvalo=fopen("testvalo", "wb");
 	dicisiontree tree;
 	
-	readtree(&tree, ftree);
+	if(readtree(&tree, ftree)<0){
+		printf("tree does not fit MAX_TREE_NUM %d, test it with decisiontree_isp_testflat\n", MAX_TREE_NUM);
+		return 1;
+	}
+	checkrows(fval, "testval", TEST_N);
 	readvalb(val, fval, TEST_N);
 	
 	test(val, &tree);
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "s4.h"
+
+#define MAX_ATTR_NUM 19
+#define MAX_ATTR_VAL 33
+#define MAX_INFO_VAL 10
+#define TRAIN_N 700
+#define TEST_BLOCK 64
+#define MAX_TREE_NUM 2227//500
+
+#define GEM5_NUMPROCS s4_numprocs()
+
+
+typedef struct value{
+	int attr[MAX_ATTR_NUM];
+	int res;
+}value;
+
+// inference model : the children of a split are contiguous, the child
+// for attribute value v is child+v. leaves have attr -1.
+typedef struct flatnode{
+	int attr;
+	int child;
+	int leaf;
+}flatnode;
+
+// dataset file : rows, attrs, classes and card[attrs] ints, then attrs
+// columns of rows unsigned chars and the class column
+typedef struct dataschema{
+	int rows;
+	int attrs;
+	int classes;
+	int card[MAX_ATTR_NUM];
+}dataschema;
+
+typedef struct testflatstruct{
+	value* val;
+	int startnum;
+	int num;
+	flatnode* flat;
+}testflatstruct;
+
+
+
+void savevalb(value* dest, FILE* fp, int num){
+	fwrite(dest, num, sizeof(value), fp);
+}
+flatnode* readflat(FILE* fp){
+	flatnode* flat;
+	int num;
+
+	fread(&num, 1, sizeof(int), fp);
+	flat=malloc(sizeof(flatnode)*num);
+	fread(flat, num, sizeof(flatnode), fp);
+	return flat;
+}
+// reads a dataset file written by convert, NULL if the rows do not fit
+// the value records testvalo is written in
+value* readset(dataschema* schema, FILE* fp){
+	value* val;
+	unsigned char* col;
+	int i, j;
+
+	fread(&schema->rows, 1, sizeof(int), fp);
+	fread(&schema->attrs, 1, sizeof(int), fp);
+	fread(&schema->classes, 1, sizeof(int), fp);
+	if(schema->rows<=0||schema->attrs<=0||schema->attrs>MAX_ATTR_NUM)
+		return NULL;
+	fread(schema->card, schema->attrs, sizeof(int), fp);
+	val=calloc(schema->rows, sizeof(value));
+	col=malloc(schema->rows);
+	for(j=0;j<=schema->attrs;j++){
+		fread(col, 1, schema->rows, fp);
+		for(i=0;i<schema->rows;i++){
+			if(j<schema->attrs)
+				val[i].attr[j]=col[i];
+			else
+				val[i].res=(col[i]==255)?-1:col[i];
+		}
+	}
+	free(col);
+	return val;
+}
+
+// rows go down the tree a block at a time : every pass moves each unfinished
+// row of the block one level, so the upper levels of the model are reused
+// by the whole block while they are still in the cache
+void* testflatfunc(void* thearg){
+	testflatstruct* arg=(testflatstruct*)thearg;
+	value* val=arg->val;
+	flatnode* flat=arg->flat;
+	int startnum=arg->startnum;
+	int end=arg->startnum+arg->num;
+	int cur[TEST_BLOCK];
+	int i, b, n;
+	int active;
+	flatnode* fnode;
+
+	for(b=startnum;b<end;b+=TEST_BLOCK){
+		n=(end-b<TEST_BLOCK)?end-b:TEST_BLOCK;
+		for(i=0;i<n;i++){
+			cur[i]=0;
+		}
+		active=n;
+		while(active>0){
+			active=0;
+			for(i=0;i<n;i++){
+				fnode=&flat[cur[i]];
+				if(fnode->attr<0)
+					continue;
+				cur[i]=fnode->child+val[b+i].attr[fnode->attr];
+				active++;
+			}
+		}
+		for(i=0;i<n;i++){
+			val[b+i].res=flat[cur[i]].leaf;
+		}
+	}
+}
+
+void testflat(value* val, int num, flatnode* flat){
+	int i;
+
+	int rest=num%(GEM5_NUMPROCS-1);
+	int count=0;
+	int nthread;
+	pthread_t thread[S4_MAX_NUMPROCS];
+	testflatstruct structs[S4_MAX_NUMPROCS];
+	if(num<GEM5_NUMPROCS){
+		nthread=num;
+		for(i=0;i<num && i<S4_MAX_NUMPROCS;i++){
+			structs[i].val=val;
+			structs[i].startnum=count;
+			structs[i].num=1;
+			structs[i].flat=flat;
+			count++;
+			pthread_create(&thread[i], NULL, testflatfunc, (void*)&structs[i]);
+		}
+	}
+	else{
+		nthread=GEM5_NUMPROCS-1;
+		for(i=0;i<GEM5_NUMPROCS-1;i++){
+			structs[i].val=val;
+			structs[i].startnum=count;
+			if(rest==0){
+				structs[i].num=num/(GEM5_NUMPROCS-1);
+			}
+			else{
+				structs[i].num=num/(GEM5_NUMPROCS-1)+1;
+				rest--;
+			}
+			structs[i].flat=flat;
+			count+=structs[i].num;
+			pthread_create(&thread[i], NULL, testflatfunc, (void*)&structs[i]);
+		}
+	}
+	for(i=0;i<nthread;i++){
+		pthread_join(thread[i], NULL);
+	}
+}
+
+int main(){
+	value* val;
+	flatnode* flat;
+	dataschema schema;
+	FILE* fflat=fopen("treeflat", "rb");
+	FILE* fval=fopen("testset", "rb");
+	FILE* fvalo;
+	int num;
+
+	flat=readflat(fflat);
+	val=readset(&schema, fval);
+	fclose(fflat);
+	fclose(fval);
+	if(val==NULL){
+		printf("testset does not fit MAX_ATTR_NUM %d\n", MAX_ATTR_NUM);
+		return 1;
+	}
+	num=schema.rows;
+
+	testflat(val, num, flat);
+
+	fvalo=fopen("testvalo", "wb");
+	savevalb(val, fvalo, num);
+	fclose(fvalo);
+	free(val);
+	free(flat);
+	return 0;
+}
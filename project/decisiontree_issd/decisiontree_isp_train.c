@@ -0,0 +1,659 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "s4.h"
+
+#define MAX_ATTR_NUM 19
+#define MAX_ATTR_VAL 33
+#define MAX_INFO_VAL 10
+// first size of the node table, it doubles whenever a split needs more
+#define TREE_NUM_INIT 2227
+
+#define ATTR_MAX {9,	16,	15,	33,	4,	10,	8,	4,	6,	6,	3,	17,	5,	4,	2,	2,	2,	2,	2}
+
+#define GEM5_NUMPROCS s4_numprocs()
+
+// stopping rules, 0 turns a rule off. a node with fewer rows than MIN_SPLIT
+// or at depth MAX_DEPTH becomes a leaf of its majority class.
+#define MIN_SPLIT 0
+#define MAX_DEPTH 0
+
+
+typedef struct value{
+	int attr[MAX_ATTR_NUM];
+	int res;
+}value;
+
+typedef struct treenode{
+	float info;
+	int treeval;//
+	int startnum;//
+	int num;//
+	int subnum;
+	int subptr[MAX_ATTR_VAL];//
+	int listcount[MAX_ATTR_VAL];
+	int attnum;//
+	int flag[MAX_ATTR_NUM];
+}treenode;
+
+// num and maxnum come first as in the per-stage kernels, node holds size entries
+typedef struct dicisiontree{
+	int num;
+	int maxnum;
+	int size;
+	struct treenode* node;
+}dicisiontree;
+
+// dataset file : rows, attrs, classes and card[attrs] ints, then attrs
+// columns of rows unsigned chars and the class column
+typedef struct dataset{
+	int rows;
+	int attrs;
+	int classes;
+	int card[MAX_ATTR_NUM];
+	unsigned char* col[MAX_ATTR_NUM];
+	unsigned char* res;
+}dataset;
+
+typedef struct levelhiststruct{
+	dataset* set;
+	dicisiontree* tree;
+	int* rownode;
+	int snum;
+	int nnum;
+	int spillnode[2];
+	int (*spill)[MAX_ATTR_NUM][MAX_ATTR_VAL][MAX_INFO_VAL];
+}levelhiststruct;
+
+// sizes of the training set, taken from the trainset schema. the
+// MAX_ attribute, value and class counts are only capacities.
+int ntrain;
+int nattr;
+int nclass;
+int subnum[MAX_ATTR_NUM];
+int minsplit=MIN_SPLIT;
+int maxdepth=MAX_DEPTH;
+// training rows in node order : node rows [startnum, startnum+num) are
+// rows rowidx[startnum] ... rowidx[startnum+num-1] of the columns
+int* rowidx;
+int* rowtmp;
+// log2(n) and n*log2(n) for every possible row count, filled by initlog2table
+double* log2n;
+double* nlog2n;
+// reads a dataset file written by convert, -1 if it does not fit the
+// MAX_ capacities of the tree
+int readset(dataset* set, FILE* fp){
+	int j;
+
+	fread(&set->rows, 1, sizeof(int), fp);
+	fread(&set->attrs, 1, sizeof(int), fp);
+	fread(&set->classes, 1, sizeof(int), fp);
+	if(set->rows<=0||set->attrs<=0||set->attrs>MAX_ATTR_NUM||set->classes>MAX_INFO_VAL)
+		return -1;
+	fread(set->card, set->attrs, sizeof(int), fp);
+	for(j=0;j<set->attrs;j++){
+		if(set->card[j]>MAX_ATTR_VAL)
+			return -1;
+	}
+	for(j=0;j<set->attrs;j++){
+		set->col[j]=malloc(set->rows);
+		fread(set->col[j], 1, set->rows, fp);
+	}
+	set->res=malloc(set->rows);
+	fread(set->res, 1, set->rows, fp);
+	return 0;
+}
+
+void savevalb(value* dest, FILE* fp, int num){
+	fwrite(dest, num, sizeof(value), fp);
+}
+
+// tree file : num and maxnum, then the maxnum nodes. the per-stage kernels
+// write all MAX_TREE_NUM nodes of their table, the readers take maxnum.
+void savetree(dicisiontree* dest, FILE* fp){
+	fwrite(&dest->num, 1, sizeof(int), fp);
+	fwrite(&dest->maxnum, 1, sizeof(int), fp);
+	fwrite(dest->node, dest->maxnum, sizeof(treenode), fp);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// takes the next node of the queue. makesubtree already decided from the
+// parent histogram whether it is a leaf, so no rows are read here.
+int checkleafnode(dataset* set, dicisiontree* tree){
+	treenode* node=&tree->node[++tree->num];
+
+	if(node->num==0||node->treeval>=0)
+		return 0;
+	else return 1;
+}
+
+void initlog2table(){
+	int n;
+	log2n[0]=0.0;
+	nlog2n[0]=0.0;
+	for(n=1;n<=ntrain;n++){
+		log2n[n]=log((double)n)/log(2.0);
+		nlog2n[n]=(double)n*log2n[n];
+	}
+}
+
+// with a = rows having value j and n = rows of class k among them,
+// a*H(j) = a*log2(a) - sum_k n*log2(n), so info = sum_j a*H(j) / num.
+// attributes already used on the path are not counted and keep info 0.
+void calcinfohist(float subinfo[][MAX_ATTR_VAL], int hist[][MAX_ATTR_VAL][MAX_INFO_VAL], int* flag, int num, float* info){
+	int i, j, k;
+	int n, a;
+	double sum;
+
+	for(i=0;i<nattr;i++){
+		if(flag[i])
+			continue;
+		sum=0.0;
+		for(j=0;j<subnum[i];j++){
+			a=0;
+			for(k=0;k<nclass;k++){
+				a+=hist[i][j][k];
+			}
+			if(a==0)
+				continue;
+			sum+=nlog2n[a];
+			for(k=0;k<nclass;k++){
+				n=hist[i][j][k];
+				if(n!=0){
+					sum-=nlog2n[n];
+					if(n!=a)
+						subinfo[i][j]+=(float)(log2n[n]-log2n[a]);
+				}
+			}
+		}
+		info[i]=(float)(sum/(double)num);
+	}
+}
+
+// majority class of the node's rows, for a node that is not split any further.
+// once every attribute is used on the path the histogram has no column left
+// to count the classes in, so they are counted from the rows.
+int majorclass(dataset* set, treenode* node){
+	int count[MAX_INFO_VAL];
+	int i, k;
+	int major=0;
+
+	memset(count, 0, sizeof(count));
+	for(i=node->startnum;i<node->startnum+node->num;i++){
+		count[set->res[rowidx[i]]]++;
+	}
+	for(k=1;k<nclass;k++){
+		if(count[k]>count[major])
+			major=k;
+	}
+	return major;
+}
+
+// returns the selected attribute, -1 when every attribute is used on the path
+int compareinfo(dataset* set, dicisiontree* tree, float* info){
+	treenode* node=&tree->node[tree->num];
+	int i;
+	int sel=-1;
+	float self=0xFFFFFFFF;
+
+	for(i=0;i<nattr;i++){
+		if(node->flag[i]==0){
+			if(self>info[i]){
+				sel=i;
+				self=info[i];
+			}
+		}
+	}
+	if(sel<0)
+		return -1;
+	node->attnum=sel;
+	node->flag[sel]=1;
+	return sel;
+}
+
+// stable counting sort of the node's entries of rowidx on the split
+// attribute, the dataset columns themselves never move
+void dividesection(dataset* set, dicisiontree* tree){
+	treenode* node=&tree->node[tree->num];
+	unsigned char* col=set->col[node->attnum];
+	int* idx=&rowidx[node->startnum];
+	int* sorted=rowtmp;
+	int pos[MAX_ATTR_VAL];
+	int i, j;
+
+	for(i=0;i<node->num;i++){
+		node->listcount[col[idx[i]]]++;
+	}
+	pos[0]=0;
+	for(j=1;j<MAX_ATTR_VAL;j++){
+		pos[j]=pos[j-1]+node->listcount[j-1];
+	}
+	for(i=0;i<node->num;i++){
+		j=col[idx[i]];
+		sorted[pos[j]++]=idx[i];
+	}
+	memcpy(idx, sorted, sizeof(int)*node->num);
+}
+
+// class of a new node of depth depth if it is a leaf, -1 if it is to be
+// split. count holds its rows per class, which is the parent histogram of
+// the split attribute at the node's value.
+int leafclass(int* count, int num, int depth){
+	int k;
+	int major=0;
+
+	for(k=1;k<nclass;k++){
+		if(count[k]>count[major])
+			major=k;
+	}
+	if(count[major]==num)
+		return major;
+	if(num<minsplit)
+		return major;
+	if(maxdepth>0&&depth>=maxdepth)
+		return major;
+	return -1;
+}
+
+void makesubtree(float subinfo[][MAX_ATTR_VAL], int hist[][MAX_ATTR_VAL][MAX_INFO_VAL], int depth, dataset* set, dicisiontree* tree){
+	treenode* node=&tree->node[tree->num];
+	treenode* nextnode;
+	int i;
+	int num=0;
+	node->subnum=subnum[node->attnum];
+	for(i=0;i<node->subnum;i++){
+		nextnode=&tree->node[tree->maxnum];
+		memcpy(nextnode, node, sizeof(treenode));
+		nextnode->startnum=node->startnum+num;
+		nextnode->num=node->listcount[i];
+		memset(nextnode->listcount, 0, 4*MAX_ATTR_VAL);
+		num+=nextnode->num;
+		node->subptr[i]=tree->maxnum;
+		tree->maxnum++;
+		nextnode->info=subinfo[node->attnum][i];
+		if(nextnode->num>0)
+			nextnode->treeval=leafclass(hist[node->attnum][i], nextnode->num, depth);
+	}
+}
+
+
+
+
+
+
+
+#define HIST_SIZE (sizeof(int)*MAX_ATTR_NUM*MAX_ATTR_VAL*MAX_INFO_VAL)
+
+#define HIST_NONE 0
+#define HIST_COUNT 1
+#define HIST_SUB 2
+#define HIST_DERIVE 3
+
+// histograms of the nodes waiting in the queue, NULL if not counted yet
+int (**nodehist)[MAX_ATTR_VAL][MAX_INFO_VAL];
+// how each queued node gets its histogram in the scan of its level
+int* histplan;
+int* histparent;
+// node of the current level owning each row, -1 if the row is not counted
+int* rownode;
+int countrows=0;
+int scanrows=0;
+
+// makes room for num nodes in the tree and the per-node queue arrays, new
+// entries are zero. returns 0 when out of memory, the old tables are kept.
+int growtree(dicisiontree* tree, int num){
+	int size=tree->size;
+	void* p;
+
+	if(num<=size)
+		return 1;
+	while(size<num)
+		size=size ? size*2 : TREE_NUM_INIT;
+	if((p=realloc(tree->node, sizeof(treenode)*size))==NULL)
+		return 0;
+	tree->node=p;
+	if((p=realloc(nodehist, sizeof(*nodehist)*size))==NULL)
+		return 0;
+	nodehist=p;
+	if((p=realloc(histplan, sizeof(int)*size))==NULL)
+		return 0;
+	histplan=p;
+	if((p=realloc(histparent, sizeof(int)*size))==NULL)
+		return 0;
+	histparent=p;
+	memset(&tree->node[tree->size], 0, sizeof(treenode)*(size-tree->size));
+	memset(&nodehist[tree->size], 0, sizeof(*nodehist)*(size-tree->size));
+	memset(&histplan[tree->size], 0, sizeof(int)*(size-tree->size));
+	memset(&histparent[tree->size], 0, sizeof(int)*(size-tree->size));
+	tree->size=size;
+	return 1;
+}
+
+void mergehist(int hist[][MAX_ATTR_VAL][MAX_INFO_VAL], int src[][MAX_ATTR_VAL][MAX_INFO_VAL], int sign){
+	int i, j, k;
+
+	for(i=0;i<MAX_ATTR_NUM;i++){
+		for(j=0;j<MAX_ATTR_VAL;j++){
+			for(k=0;k<MAX_INFO_VAL;k++){
+				hist[i][j][k]+=sign*src[i][j][k];
+			}
+		}
+	}
+}
+
+// counts the rows [snum, snum+nnum) into the histograms of their nodes.
+// a node crossing the edge of the range is shared with the next thread, so
+// its rows go to a private spill histogram that is merged after the join.
+// only the first and the last node of the range can cross it. the rows of
+// a node are contiguous, so its part of the range is counted one column at
+// a time, skipping the attributes already used on its path.
+void* levelhistfunc(void* thearg){
+	levelhiststruct* arg=(levelhiststruct*)thearg;
+	dataset* set=arg->set;
+	treenode* tnode=arg->tree->node;
+	int* rownode=arg->rownode;
+	int lo=arg->snum;
+	int hi=arg->snum+arg->nnum;
+	int (*hist)[MAX_ATTR_VAL][MAX_INFO_VAL];
+	unsigned char* col;
+	unsigned char* res=set->res;
+	int i, j, n, s, e, r;
+
+	arg->spillnode[0]=-1;
+	arg->spillnode[1]=-1;
+	i=lo;
+	while(i<hi){
+		n=rownode[i];
+		if(n<0){
+			i++;
+			continue;
+		}
+		e=tnode[n].startnum+tnode[n].num;
+		if(tnode[n].startnum<lo||e>hi){
+			s=(tnode[n].startnum<lo)?0:1;
+			arg->spillnode[s]=n;
+			memset(arg->spill[s], 0, HIST_SIZE);
+			hist=arg->spill[s];
+		}
+		else
+			hist=nodehist[n];
+		if(e>hi)
+			e=hi;
+		for(j=0;j<nattr;j++){
+			if(tnode[n].flag[j])
+				continue;
+			col=set->col[j];
+			for(r=i;r<e;r++){
+				hist[j][col[rowidx[r]]][res[rowidx[r]]]++;
+			}
+		}
+		i=e;
+	}
+}
+
+// one scan of the training rows counts every node of the level [first, last)
+// planned for counting, then the derived nodes are made by subtraction
+void levelhist(dataset* set, dicisiontree* tree, int first, int last){
+	treenode* node;
+	int (*hist)[MAX_ATTR_VAL][MAX_INFO_VAL];
+	int i, j, n;
+	int snum=0;
+	int nthread;
+
+	int rest=ntrain%(GEM5_NUMPROCS-1);
+	pthread_t thread[S4_MAX_NUMPROCS];
+	levelhiststruct structs[S4_MAX_NUMPROCS];
+	static int spill[S4_MAX_NUMPROCS][2][MAX_ATTR_NUM][MAX_ATTR_VAL][MAX_INFO_VAL];
+
+	for(i=0;i<ntrain;i++)
+		rownode[i]=-1;
+	for(n=first;n<last;n++){
+		if(histplan[n]!=HIST_COUNT&&histplan[n]!=HIST_SUB)
+			continue;
+		node=&tree->node[n];
+		nodehist[n]=calloc(1, HIST_SIZE);
+		for(i=node->startnum;i<node->startnum+node->num;i++)
+			rownode[i]=n;
+		countrows+=node->num;
+	}
+
+	for(i=0;i<GEM5_NUMPROCS;i++){
+		structs[i].set=set;
+		structs[i].tree=tree;
+		structs[i].rownode=rownode;
+		structs[i].spill=spill[i];
+	}
+	if(ntrain<GEM5_NUMPROCS){
+		nthread=ntrain;
+		for(i=0;i<ntrain && i<S4_MAX_NUMPROCS;i++){
+			structs[i].snum=snum;
+			structs[i].nnum=1;
+			pthread_create(&thread[i], NULL, levelhistfunc, (void*)&structs[i]);
+			snum++;
+		}
+	}
+	else{
+		nthread=GEM5_NUMPROCS-1;
+		for(i=0;i<GEM5_NUMPROCS-1;i++){
+			structs[i].snum=snum;
+			if(rest==0){
+				structs[i].nnum=ntrain/(GEM5_NUMPROCS-1);
+			}
+			else{
+				structs[i].nnum=ntrain/(GEM5_NUMPROCS-1)+1;
+				rest--;
+			}
+			pthread_create(&thread[i], NULL, levelhistfunc, (void*)&structs[i]);
+			snum+=structs[i].nnum;
+		}
+	}
+	for(i=0;i<nthread;i++){
+		pthread_join(thread[i], NULL);
+	}
+	for(i=0;i<nthread;i++){
+		for(j=0;j<2;j++){
+			if(structs[i].spillnode[j]>=0)
+				mergehist(nodehist[structs[i].spillnode[j]], structs[i].spill[j], 1);
+		}
+	}
+
+	for(n=first;n<last;n++){
+		if(histplan[n]!=HIST_DERIVE)
+			continue;
+		node=&tree->node[histparent[n]];
+		hist=nodehist[histparent[n]];
+		nodehist[histparent[n]]=NULL;
+		for(i=0;i<node->subnum;i++){
+			j=node->subptr[i];
+			if(histplan[j]==HIST_COUNT||histplan[j]==HIST_SUB)
+				mergehist(hist, nodehist[j], -1);
+		}
+		nodehist[n]=hist;
+	}
+	for(n=first;n<last;n++){
+		if(histplan[n]==HIST_SUB){
+			free(nodehist[n]);
+			nodehist[n]=NULL;
+		}
+	}
+}
+
+// the parent histogram is the sum of its children's, so the largest child
+// is derived as parent minus siblings instead of being counted. that pays
+// off as long as the leaf siblings, which would otherwise not be counted
+// at all, have fewer rows than the largest child. the parent histogram is
+// kept until the scan of the next level has counted the siblings.
+void plansubhist(int hist[][MAX_ATTR_VAL][MAX_INFO_VAL], dicisiontree* tree){
+	treenode* node=&tree->node[tree->num];
+	treenode* sub;
+	int i, n;
+	int big=0;
+	int leafnum=0;
+	int derive;
+
+	for(i=1;i<node->subnum;i++){
+		if(tree->node[node->subptr[i]].num>tree->node[node->subptr[big]].num)
+			big=i;
+	}
+	for(i=0;i<node->subnum;i++){
+		sub=&tree->node[node->subptr[i]];
+		if(i!=big&&sub->treeval>=0)
+			leafnum+=sub->num;
+	}
+	sub=&tree->node[node->subptr[big]];
+	derive=(sub->num>0&&sub->treeval<0&&leafnum<sub->num);
+
+	for(i=0;i<node->subnum;i++){
+		n=node->subptr[i];
+		sub=&tree->node[n];
+		histplan[n]=HIST_NONE;
+		if(sub->num==0)
+			continue;
+		if(i==big&&derive){
+			histplan[n]=HIST_DERIVE;
+			histparent[n]=tree->num;
+		}
+		else if(sub->treeval<0)
+			histplan[n]=HIST_COUNT;
+		else if(derive)
+			histplan[n]=HIST_SUB;
+	}
+	if(derive)
+		nodehist[tree->num]=hist;
+	else
+		free(hist);
+}
+
+// builds the whole tree in one process, one depth level at a time.
+// tree->num is the head of the node queue and tree->maxnum its tail :
+// makesubtree appends the children of a split at maxnum, so the nodes
+// between the head and the tail at the start of a round are exactly one
+// level, and they keep the breadth-first numbering that treeinfo.txt
+// schedules for the per-stage binaries. the histograms of the whole level
+// come from one parallel scan of the rows instead of one scan per node.
+void train(dataset* set, dicisiontree* tree){
+	treenode* node;
+	int (*hist)[MAX_ATTR_VAL][MAX_INFO_VAL];
+	float info[MAX_ATTR_NUM];
+	float subinfo[MAX_ATTR_NUM][MAX_ATTR_VAL];
+	int levelend;
+	int level=0;
+	int cutoff=0;
+
+	histplan[0]=HIST_COUNT;
+	while(tree->num+1<tree->maxnum){
+		levelend=tree->maxnum;
+		levelhist(set, tree, tree->num+1, levelend);
+		level++;
+		while(tree->num+1<levelend){
+			if(checkleafnode(set, tree)==0)
+				continue;
+			node=&tree->node[tree->num];
+
+			hist=nodehist[tree->num];
+			nodehist[tree->num]=NULL;
+			scanrows+=node->num;
+
+			memset(info, 0, sizeof(info));
+			memset(subinfo, 0, sizeof(subinfo));
+			calcinfohist(subinfo, hist, node->flag, node->num, info);
+
+			if(compareinfo(set, tree, info)<0){
+				node->treeval=majorclass(set, node);
+				free(hist);
+				continue;
+			}
+			if(!growtree(tree, tree->maxnum+subnum[node->attnum])){
+				node=&tree->node[tree->num];
+				node->treeval=majorclass(set, node);
+				free(hist);
+				cutoff++;
+				continue;
+			}
+			dividesection(set, tree);
+			makesubtree(subinfo, hist, level, set, tree);
+			plansubhist(hist, tree);
+		}
+	}
+	if(cutoff>0)
+		printf("warning: out of memory for the node table at %d nodes, %d nodes were not split\n", tree->maxnum, cutoff);
+	printf("levels %d, histogram rows counted %d of %d\n", level, countrows, scanrows);
+}
+
+// argv : MIN_SPLIT and MAX_DEPTH
+int main(int argc, char* argv[]){
+	static dataset set;
+	value* sorted;
+	FILE* fval=fopen("trainset", "rb");
+	FILE* ftree;
+	static dicisiontree tree={-1,1,0,NULL};
+	int i, j;
+	
+	if(argc>1)
+		minsplit=atoi(argv[1]);
+	if(argc>2)
+		maxdepth=atoi(argv[2]);
+	j=readset(&set, fval);
+	fclose(fval);
+	if(j<0){
+		printf("trainset does not fit MAX_ATTR_NUM %d, MAX_ATTR_VAL %d, MAX_INFO_VAL %d\n", MAX_ATTR_NUM, MAX_ATTR_VAL, MAX_INFO_VAL);
+		return 1;
+	}
+	ntrain=set.rows;
+	nattr=set.attrs;
+	nclass=set.classes;
+	for(i=0;i<nattr;i++)
+		subnum[i]=set.card[i];
+	if(!growtree(&tree, 1)){
+		printf("out of memory for the node table\n");
+		return 1;
+	}
+	tree.node[0].info=1.0f;
+	tree.node[0].treeval=-1;
+	for(i=nattr;i<MAX_ATTR_NUM;i++)
+		tree.node[0].flag[i]=1;
+	tree.node[0].num=ntrain;
+
+	rowidx=malloc(sizeof(int)*ntrain);
+	rowtmp=malloc(sizeof(int)*ntrain);
+	rownode=malloc(sizeof(int)*ntrain);
+	log2n=malloc(sizeof(double)*(ntrain+1));
+	nlog2n=malloc(sizeof(double)*(ntrain+1));
+	initlog2table();
+	for(i=0;i<ntrain;i++)
+		rowidx[i]=i;
+
+	train(&set, &tree);
+	// the val file keeps the rows in node order, as the divide stage leaves it
+	sorted=calloc(ntrain, sizeof(value));
+	for(i=0;i<ntrain;i++){
+		for(j=0;j<nattr;j++)
+			sorted[i].attr[j]=set.col[j][rowidx[i]];
+		sorted[i].res=set.res[rowidx[i]];
+	}
+	
+	ftree=fopen("tree", "wb");
+	savetree(&tree, ftree);
+	fclose(ftree);
+	fval=fopen("val", "wb");
+	savevalb(sorted, fval, ntrain);
+	fclose(fval);
+	free(sorted);
+	return 0;
+}
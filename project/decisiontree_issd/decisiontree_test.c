@@ -7,7 +7,7 @@
 #define MAX_ATTR_VAL 33
 #define MAX_INFO_VAL 10
 #define TRAIN_N 700
-#define TEST_N 150
+#define TEST_N 8500
 #define MAX_TREE_NUM 2227//500
 
 #define ATTR_MAX {9,	16,	15,	33,	4,	10,	8,	4,	6,	6,	3,	17,	5,	4,	2,	2,	2,	2,	2}
@@ -411,7 +411,7 @@ void test(value* val, dicisiontree* tree){
 
 
 int main(){
-	value val[TEST_N];
+	static value val[TEST_N];
 	FILE* ftree=fopen("tree", "rb");
 	FILE* fval=fopen("testval", "rb");
 	FILE* fvalo=fopen("testvalo", "wb");
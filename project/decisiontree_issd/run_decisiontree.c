@@ -1,11 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "isp.h"
+#include "isp_stats.h"
 
 #define issd_clock 400
 #define issd_numcpu 4
+// 1 : build the whole tree in one decisiontree_isp_train run,
+// 0 : run the per-node stages scheduled by treeinfo.txt
+#define issd_wholetree 1
+// 1 : export the tree to the flat model and test with decisiontree_isp_testflat,
+// 0 : test with decisiontree_isp_test on the training tree
+#define issd_flattest 1
+// 1 : also train a random forest of forest_trees trees with decisiontree_isp_forest
+// and save its test predictions as test_forest_*.txt
+#define issd_forest 0
+#define forest_trees 16
 
 
+// a leaf only advances the node queue, which decisiontree_isp_calc does
+// before it calculates anything
 void doone(int cpuhz, int numcpu, int num, isp_device_id device, FILE* ifp){
 	char cmd[128];
 	char pname[64];
@@ -13,11 +26,11 @@ void doone(int cpuhz, int numcpu, int num, isp_device_id device, FILE* ifp){
 	char clock[32];
 int cycle;
 	sprintf(clock, "%dMHz", cpuhz);
-	sprintf(funcname, "check");
+	sprintf(funcname, "calc");
 	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	sprintf(cmd, "mv ./m5out/stats.txt ./m5out/decisiontree_%s_%d_%dMHz_%d.txt", funcname, numcpu, cpuhz, num);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz_%d", funcname, numcpu, cpuhz, num);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
-	system(cmd);
+	ispStatsCollect(cmd);
 }
 
 void doall(int cpuhz, int numcpu, int num, isp_device_id device, FILE* ifp){
@@ -28,35 +41,29 @@ void doall(int cpuhz, int numcpu, int num, isp_device_id device, FILE* ifp){
 int cycle;
 	sprintf(clock, "%dMHz", cpuhz);
 
-sprintf(funcname, "check");
-	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	sprintf(cmd, "mv ./m5out/stats.txt ./m5out/decisiontree_%s_%d_%dMHz_%d.txt", funcname, numcpu, cpuhz, num);
-	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
-	system(cmd);
-	
 	sprintf(funcname, "calc");
 	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	sprintf(cmd, "mv ./m5out/stats.txt ./m5out/decisiontree_%s_%d_%dMHz_%d.txt", funcname, numcpu, cpuhz, num);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz_%d", funcname, numcpu, cpuhz, num);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "compare");
 	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	sprintf(cmd, "mv ./m5out/stats.txt ./m5out/decisiontree_%s_%d_%dMHz_%d.txt", funcname, numcpu, cpuhz, num);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz_%d", funcname, numcpu, cpuhz, num);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "divide");
 	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	sprintf(cmd, "mv ./m5out/stats.txt ./m5out/decisiontree_%s_%d_%dMHz_%d.txt", funcname, numcpu, cpuhz, num);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz_%d", funcname, numcpu, cpuhz, num);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
-	system(cmd);
+	ispStatsCollect(cmd);
 	
 	sprintf(funcname, "makesub");
 	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	sprintf(cmd, "mv ./m5out/stats.txt ./m5out/decisiontree_%s_%d_%dMHz_%d.txt", funcname, numcpu, cpuhz, num);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz_%d", funcname, numcpu, cpuhz, num);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
-	system(cmd);
+	ispStatsCollect(cmd);
 }
 
 void test(int cpuhz, int numcpu, isp_device_id device, FILE* ifp){
@@ -68,9 +75,45 @@ void test(int cpuhz, int numcpu, isp_device_id device, FILE* ifp){
 	sprintf(clock, "%dMHz", cpuhz);
 	sprintf(funcname, "test");
 	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	sprintf(cmd, "mv ./m5out/stats.txt ./m5out/decisiontree_%s_%d_%dMHz.txt", funcname, numcpu, cpuhz);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz", funcname, numcpu, cpuhz);
+	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
+	ispStatsCollect(cmd);
+}
+
+void testflat(int cpuhz, int numcpu, isp_device_id device, FILE* ifp){
+	char cmd[128];
+	char pname[64];
+	char funcname[64];
+	char clock[32];
+	int cycle;
+	sprintf(clock, "%dMHz", cpuhz);
+	sprintf(funcname, "export");
+	sprintf(pname, "./decisiontree_isp_%s", funcname);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz", funcname, numcpu, cpuhz);
+	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
+	ispStatsCollect(cmd);
+
+	sprintf(funcname, "testflat");
+	sprintf(pname, "./decisiontree_isp_%s", funcname);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz", funcname, numcpu, cpuhz);
 	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, clock);
-	system(cmd);
+	ispStatsCollect(cmd);
+}
+
+void forest(int cpuhz, int numcpu, isp_device_id device, FILE* ifp){
+	char cmd[128];
+	char pname[64];
+	char funcname[64];
+	char clock[32];
+	char arg[32];
+	int cycle;
+	sprintf(clock, "%dMHz", cpuhz);
+	sprintf(arg, "%d", forest_trees);
+	sprintf(funcname, "forest");
+	sprintf(pname, "./decisiontree_isp_%s", funcname);
+	sprintf(cmd, "decisiontree_%s_%d_%dMHz_%d", funcname, numcpu, cpuhz, forest_trees);
+	cycle = ispRunBinaryFileEx(device, pname, arg, "output.txt", numcpu, clock);
+	ispStatsCollect(cmd);
 }
 
 int main(int argc, const char* argv[])
@@ -87,32 +130,57 @@ int main(int argc, const char* argv[])
 	char funcname[64];
 	int numcpu=issd_numcpu;
 	int clock=issd_clock;
+	if(argc>1) numcpu=atoi(argv[1]);
+	if(argc>2) clock=atoi(argv[2]);
 	int a, b;
 	FILE* treeinfof;
 	sprintf(cpuhz, "%dMHz", clock);
 	system("./convert");
-	sprintf(funcname, "read");
-	sprintf(pname, "./decisiontree_isp_%s", funcname);
-	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	treeinfof=fopen("treeinfo.txt", "r");
-	while(1){
-		fscanf(treeinfof, "%d %d", &a, &b);
-		if(a==-1)
-			break;
-		if(b==1)
-			doone(clock, numcpu, a, device, ifp);
-		else
-			doall(clock, numcpu, a, device, ifp);
+	if(issd_wholetree){
+		sprintf(funcname, "train");
+		sprintf(pname, "./decisiontree_isp_%s", funcname);
+		sprintf(cmd, "decisiontree_%s_%d_%s", funcname, numcpu, cpuhz);
+		cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
+		ispStatsCollect(cmd);
 	}
-	fclose(treeinfof);
-	test(clock, numcpu, device, ifp);
+	else{
+		sprintf(funcname, "read");
+		sprintf(pname, "./decisiontree_isp_%s", funcname);
+		sprintf(cmd, "decisiontree_%s_%d_%s", funcname, numcpu, cpuhz);
+		cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
+		ispStatsCollect(cmd);
+		treeinfof=fopen("treeinfo.txt", "r");
+		while(1){
+			fscanf(treeinfof, "%d %d", &a, &b);
+			if(a==-1)
+				break;
+			if(b==1)
+				doone(clock, numcpu, a, device, ifp);
+			else
+				doall(clock, numcpu, a, device, ifp);
+		}
+		fclose(treeinfof);
+	}
+	if(issd_flattest)
+		testflat(clock, numcpu, device, ifp);
+	else
+		test(clock, numcpu, device, ifp);
 
 	system("./convertrev");
-	sprintf(pname, "cp test2.txt test_%d_%s.txt", numcpu, cpuhz);
-	system(pname);
-	sprintf(pname, "cp treeout.txt tree_%d_%s.txt", numcpu, cpuhz);
-	system(pname);
+	sprintf(pname, "test_%d_%s.txt", numcpu, cpuhz);
+	ispCopyFile("test2.txt", pname);
+	sprintf(pname, "tree_%d_%s.txt", numcpu, cpuhz);
+	ispCopyFile("treeout.txt", pname);
+
+	if(issd_forest){
+		forest(clock, numcpu, device, ifp);
+		system("./convertrev");
+		sprintf(pname, "test_forest_%d_%s.txt", numcpu, cpuhz);
+		ispCopyFile("test2.txt", pname);
+	}
 
-	printf("ISP cycle = %d\n", cycle);
+	sprintf(cmd, "./m5out/decisiontree_stats_%d_%s.csv", numcpu, cpuhz);
+	ispStatsWrite(cmd);
+	printf("ISP cycle = %lld\n", ispStatsTotalTicks());
 	return 0;
 }
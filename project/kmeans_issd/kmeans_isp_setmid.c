@@ -3,7 +3,7 @@
 #include "s4.h"
 #include "pthread.h"
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 #define K 20
 #define N 10000
@@ -49,10 +49,10 @@ void savekstruct(kmeansstruct* s, FILE* fp, int num){
 	fprintf(fp, "Tran #%04d - x: %f, y: %f, z: %f, k: %d\n", num, s->x, s->y, s->z, s->k);
 }
 void savekmeansb(kmeansstruct* s, FILE* fp, int num){
-	fwrite(s, sizeof(kmeansstruct), num, fp);
+	s4_fwrite(s, sizeof(kmeansstruct), num, fp);
 }
 void readkmeansb(kmeansstruct* s, FILE* fp, int num){
-	fread(s, sizeof(kmeansstruct), num, fp);
+	s4_fread(s, sizeof(kmeansstruct), num, fp);
 }
 void setclustmid(kmeansstruct* datas, kmeansstruct* klist){
 	int knum[K];
@@ -112,16 +112,16 @@ void setclust(kmeansstruct* datas, kmeansstruct* klist){
 	int i;
 	int count=0;
 	int rest=N%(GEM5_NUMPROCS-1);
-	pthread_t thread[GEM5_NUMPROCS];
-	setcluststruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	setcluststruct structs[S4_MAX_NUMPROCS];
 	if(N<GEM5_NUMPROCS){
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			structs[i].klist=klist;
 			structs[i].data=&datas[i];
 			structs[i].num=1;
 			pthread_create(&thread[i], NULL, setclustfunc, (void*)&structs[i]);
 		}
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
@@ -194,17 +194,17 @@ int calcclustmid(kmeansstruct* datas, kmeansstruct* klist){
 	int retu[K];
 	int count=0;
 	int rest=K%(GEM5_NUMPROCS-1);
-	pthread_t thread[GEM5_NUMPROCS];
-	calcclustmidstruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	calcclustmidstruct structs[S4_MAX_NUMPROCS];
 	if(K<GEM5_NUMPROCS){
-		for(i=0;i<K;i++){
+		for(i=0;i<K && i<S4_MAX_NUMPROCS;i++){
 			structs[i].datas=datas;
 			structs[i].klist=&klist[i];
 			structs[i].clustnum=i;
 			structs[i].num=1;
 			pthread_create(&thread[i], NULL, calcclustmidfunc, (void*)&structs[i]);
 		}
-		for(i=0;i<K;i++){
+		for(i=0;i<K && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], (void**)&retu[i]);
 			if(ret==0){
 				if(retu[i]==1)
@@ -243,15 +243,15 @@ int kmeans(int T){
 	int i;
 	kmeansstruct kdata[N];
 	kmeansstruct klist[K];
-	FILE* fp=fopen("kdata", "rb");
-	FILE* output=fopen("kclust", "wb");
+	FILE* fp=s4_fopen("kdata", "rb");
+	FILE* output=s4_fopen("kclust", "wb");
 
 	readkmeansb(kdata, fp, N);
 	setclustmid(kdata, klist);
 	savekmeansb(klist, output, K);
 
-	fclose(output);
-	fclose(fp);
+	s4_fclose(output);
+	s4_fclose(fp);
 	return 0;
 }
 
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "isp.h"
+#include "isp_stats.h"
 
 #define issd_clock 400
 #define issd_numcpu 4
@@ -21,25 +22,29 @@ int main(int argc, const char* argv[])
 	char cpuhz[16];
 	int numcpu=issd_numcpu;
 	int clock=issd_clock;
+	if(argc>1) numcpu=atoi(argv[1]);
+	if(argc>2) clock=atoi(argv[2]);
 	sprintf(cpuhz, "%dMHz", clock);
-	sprintf(str1, "cp m5out/stats.txt m5out/stats_%d_%s_read.txt", numcpu, cpuhz);
-	sprintf(str2, "cp m5out/stats.txt m5out/stats_%d_%s_setmid.txt", numcpu, cpuhz);
-	sprintf(str5, "cp m5out/stats.txt m5out/stats_%d_%s_write.txt", numcpu, cpuhz);
+	sprintf(str1, "kmeans_%d_%s_read", numcpu, cpuhz);
+	sprintf(str2, "kmeans_%d_%s_setmid", numcpu, cpuhz);
+	sprintf(str5, "kmeans_%d_%s_write", numcpu, cpuhz);
 	
 	cycle = ispRunBinaryFileEx(device, "./kmeans_isp_read", NULL, "output.txt", numcpu, cpuhz);
-	system(str1);
+	ispStatsCollect(str1);
 	cycle = ispRunBinaryFileEx(device, "./kmeans_isp_setmid", "1", "output.txt", numcpu, cpuhz);
-	system(str2);
+	ispStatsCollect(str2);
 	for(i=0;i<30;i++){
-		sprintf(str3, "cp m5out/stats.txt m5out/stats_%d_%s_setclust_%d.txt", numcpu, cpuhz, i+1);
-		sprintf(str4, "cp m5out/stats.txt m5out/stats_%d_%s_calcmid_%d.txt", numcpu, cpuhz, i+1);
+		sprintf(str3, "kmeans_%d_%s_setclust_%d", numcpu, cpuhz, i+1);
+		sprintf(str4, "kmeans_%d_%s_calcmid_%d", numcpu, cpuhz, i+1);
 		cycle = ispRunBinaryFileEx(device, "./kmeans_isp_setclust", NULL, "output.txt", numcpu, cpuhz);
-		system(str3);
+		ispStatsCollect(str3);
 		cycle = ispRunBinaryFileEx(device, "./kmeans_isp_calcmid", NULL, "output.txt", numcpu, cpuhz);
-		system(str4);
+		ispStatsCollect(str4);
 	}
 	cycle = ispRunBinaryFileEx(device, "./kmeans_isp_write", NULL, "output.txt", numcpu, cpuhz);
-	system(str5);
+	ispStatsCollect(str5);
 
-	printf("ISP cycle = %d\n", cycle);
+	sprintf(str1, "./m5out/kmeans_stats_%d_%s.csv", numcpu, cpuhz);
+	ispStatsWrite(str1);
+	printf("ISP cycle = %lld\n", ispStatsTotalTicks());
 }
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include "s4.h"
+
+#define N 7115
+#define damp 0.85
+
+#define GEM5_NUMPROCS s4_numprocs()
+
+typedef struct linkmapcsrvalue{
+	int col;
+	float value;
+}linkmapcsrvalue;
+
+typedef struct linkmapcsr{
+	int outnumzero[1005];
+	int rownum[7116];
+	linkmapcsrvalue value[103689];
+}linkmapcsr;
+
+// compressed csr : column ids are gap-encoded as varints per row,
+// edge values are rebuilt from the out-degree of the source column.
+#define CSRZ_MAX_BYTES (103689*5)
+
+typedef struct linkmapcsrz{
+	int outnumzero[1005];
+	int outdeg[N];
+	int rowbyte[N+1];
+	int nbytes;
+	unsigned char col[CSRZ_MAX_BYTES];
+}linkmapcsrz;
+
+void savemapz(linkmapcsrz* dest, FILE* fp){
+	s4_fwrite(dest, offsetof(linkmapcsrz, col), 1, fp);
+	s4_fwrite(dest->col, sizeof(unsigned char), dest->nbytes, fp);
+}
+
+int putvarint(unsigned char* dest, int val){
+	int n=0;
+	while(val>=0x80){
+		dest[n++]=(unsigned char)(val&0x7F)|0x80;
+		val>>=7;
+	}
+	dest[n++]=(unsigned char)val;
+	return n;
+}
+
+// every edge of source column c carries 1/outdeg(c), so the float
+// values collapse to one out-degree per node and the sorted column ids
+// of each row are stored as gaps from the previous column.
+// returns 0 when a row is not sorted, the gaps would be negative.
+int compressmap(linkmapcsrz* dest, const linkmapcsr* map){
+	int i, j, col, prev;
+	int k=0;
+
+	for(i=0;i<1005;i++){
+		dest->outnumzero[i]=map->outnumzero[i];
+	}
+	for(i=0;i<N;i++){
+		dest->outdeg[i]=0;
+	}
+	for(i=0;i<N;i++){
+		dest->rowbyte[i]=k;
+		prev=0;
+		for(j=map->rownum[i];j<map->rownum[i+1];j++){
+			col=map->value[j].col;
+			if(col<prev){
+				printf("csrmap row %d is not sorted: column %d after %d\n", i, col, prev);
+				return 0;
+			}
+			dest->outdeg[col]=(int)(1.0f/map->value[j].value+0.5f);
+			k+=putvarint(&dest->col[k], col-prev);
+			prev=col;
+		}
+	}
+	dest->rowbyte[N]=k;
+	dest->nbytes=k;
+	return 1;
+}
+
+int main(){
+	FILE* mapinput=s4_fopen("csrmap", "rb");
+	FILE* mapoutput;
+	
+	// the map is read in place, not copied to the stack
+	const linkmapcsr* mapcsr;
+	static linkmapcsrz mapcsrz;
+	int ok;
+	
+	s4_init_simulation();
+	mapcsr=(const linkmapcsr*)s4_map(mapinput, 0, sizeof(linkmapcsr));
+	if(mapcsr==NULL){
+		printf("cannot map csrmap\n");
+		return 1;
+	}
+	ok=compressmap(&mapcsrz, mapcsr);
+	s4_unmap(mapcsr);
+	s4_fclose(mapinput);
+	
+	// leave no stale csrmapz for updaterankz to read
+	if(!ok){
+		remove("csrmapz");
+		s4_wrapup_simulation();
+		return 1;
+	}
+	
+	mapoutput=s4_fopen("csrmapz", "wb");
+	savemapz(&mapcsrz, mapoutput);
+
+	printf("csrmap %d bytes, csrmapz %d bytes\n", (int)sizeof(linkmapcsr), (int)(offsetof(linkmapcsrz, col)+mapcsrz.nbytes));
+
+	s4_fclose(mapoutput);
+	s4_wrapup_simulation();
+	
+	return 0;
+}
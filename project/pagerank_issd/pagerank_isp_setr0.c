@@ -2,13 +2,14 @@
 #include <stdlib.h>
 #include <time.h>
 #include <pthread.h>
+#include "s4.h"
 
 #define N 7115
 #define damp 0.85
 
 #define ERROR 0.000001
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 typedef struct linkmapcsrvalue{
 	int col;
@@ -30,6 +31,94 @@ typedef struct updatestruct{
 	float defaultvalue;
 }updatestruct;
 
+// rank vector storage precision, selected by the first program argument.
+// fp16/bf16 halve the rank file and the rankvec gathers, sums stay in fp32.
+// fp64acc keeps fp32 storage and accumulates in double for large graphs.
+#define PREC_FP32 0
+#define PREC_FP16 1
+#define PREC_BF16 2
+#define PREC_FP64ACC 3
+
+int rankprec=PREC_FP32;
+
+typedef union floatbits{
+	float f;
+	unsigned int u;
+}floatbits;
+
+unsigned short floattohalf(float f){
+	floatbits v;
+	unsigned int sign, mant, half, rem, halfway;
+	int exp, shift;
+	v.f=f;
+	sign=(v.u>>16)&0x8000;
+	exp=(int)((v.u>>23)&0xFF);
+	mant=v.u&0x7FFFFF;
+	if(exp==0xFF)
+		return sign|0x7C00|(mant?0x200:0);
+	exp=exp-127+15;
+	if(exp>=0x1F)
+		return sign|0x7C00;
+	if(exp<=0){
+		if(exp<-10)
+			return sign;
+		mant|=0x800000;
+		shift=14-exp;
+		half=mant>>shift;
+		rem=mant&((1u<<shift)-1);
+		halfway=1u<<(shift-1);
+		if(rem>halfway||(rem==halfway&&(half&1)))
+			half++;
+		return sign|half;
+	}
+	half=((unsigned int)exp<<10)|(mant>>13);
+	rem=mant&0x1FFF;
+	if(rem>0x1000||(rem==0x1000&&(half&1)))
+		half++;
+	return sign|half;
+}
+
+float halftofloat(unsigned short h){
+	floatbits v;
+	unsigned int sign=((unsigned int)h&0x8000)<<16;
+	unsigned int exp=(h>>10)&0x1F;
+	unsigned int mant=h&0x3FF;
+	int e;
+	if(exp!=0&&exp!=0x1F){
+		v.u=sign|((exp+112)<<23)|(mant<<13);
+	}
+	else if(exp==0x1F){
+		v.u=sign|0x7F800000|(mant<<13);
+	}
+	else if(mant==0){
+		v.u=sign;
+	}
+	else{
+		e=1;
+		while(!(mant&0x400)){
+			mant<<=1;
+			e--;
+		}
+		mant&=0x3FF;
+		v.u=sign|((unsigned int)(e+112)<<23)|(mant<<13);
+	}
+	return v.f;
+}
+
+unsigned short floattobf16(float f){
+	floatbits v;
+	v.f=f;
+	if((v.u&0x7FFFFFFF)>0x7F800000)
+		return (unsigned short)((v.u>>16)|0x40);
+	return (unsigned short)((v.u+0x7FFF+((v.u>>16)&1))>>16);
+}
+
+float bf16tofloat(unsigned short h){
+	floatbits v;
+	v.u=(unsigned int)h<<16;
+	return v.f;
+}
+
 void savemap(linkmapcsr* dest, FILE* fp){
 	fwrite(dest, sizeof(linkmapcsr), 1, fp);
 }
@@ -39,11 +128,37 @@ void loadmap(linkmapcsr* dest, FILE* fp){
 }
 
 void saverank(float* dest, FILE* fp){
-	fwrite(dest, sizeof(float), N, fp);
+	unsigned short half[N];
+	int i;
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16){
+		for(i=0;i<N;i++){
+			if(rankprec==PREC_FP16)
+				half[i]=floattohalf(dest[i]);
+			else
+				half[i]=floattobf16(dest[i]);
+		}
+		fwrite(half, sizeof(unsigned short), N, fp);
+	}
+	else{
+		fwrite(dest, sizeof(float), N, fp);
+	}
 }
 
 void loadrank(float* dest, FILE* fp){
-	fread(dest, sizeof(float), N, fp);
+	unsigned short half[N];
+	int i;
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16){
+		fread(half, sizeof(unsigned short), N, fp);
+		for(i=0;i<N;i++){
+			if(rankprec==PREC_FP16)
+				dest[i]=halftofloat(half[i]);
+			else
+				dest[i]=bf16tofloat(half[i]);
+		}
+	}
+	else{
+		fread(dest, sizeof(float), N, fp);
+	}
 }
 
 void genrank0(float* dest){
@@ -122,8 +237,8 @@ void* updaterankfunc(void* thearg){
 
 void updaterank(float* dest, linkmapcsr* map, float* rankvec){
 	int i, j, count=0;
-	pthread_t thread[GEM5_NUMPROCS];
-	updatestruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	updatestruct structs[S4_MAX_NUMPROCS];
 	float* destp=dest;
 	int rest=N%(GEM5_NUMPROCS-1);
 	float defaultvalue=0.0f;
@@ -133,7 +248,7 @@ void updaterank(float* dest, linkmapcsr* map, float* rankvec){
 	}
 	defaultvalue/=(float)N;
 	if(N<GEM5_NUMPROCS){
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			structs[i].dest=destp;
 			structs[i].map=map;
 			structs[i].rankvec=rankvec;
@@ -143,7 +258,7 @@ void updaterank(float* dest, linkmapcsr* map, float* rankvec){
 			pthread_create(&thread[i], NULL, updaterankfunc, (void*)&structs[i]);
 			destp++;
 		}
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
@@ -171,10 +286,13 @@ void updaterank(float* dest, linkmapcsr* map, float* rankvec){
 	}
 }
 
-int main(){
+int main(int argc, char* argv[]){
 	FILE* rankoutput=fopen("rankcsr", "wb");
 	
 	float next[N];
+
+	if(argc>1)
+		rankprec=atoi(argv[1]);
 	
 	genrank0(next);
 	saverank(next, rankoutput);
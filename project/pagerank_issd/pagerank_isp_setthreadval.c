@@ -2,13 +2,14 @@
 #include <stdlib.h>
 #include <time.h>
 #include <pthread.h>
+#include "s4.h"
 
 #define N 7115
 #define damp 0.85
 
 #define ERROR 0.000001
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 typedef struct linkmapcsrvalue{
 	int col;
@@ -132,7 +133,7 @@ void setthreadval(threadval* val, linkmapcsr* map){
 	int i, j=0, count=0;
 	int rest=N%(GEM5_NUMPROCS-1);
 	if(N<GEM5_NUMPROCS){
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			val[i].count=i;
 			val[i].num=1;
 		}
@@ -168,12 +169,12 @@ void* updaterankfunc(void* thearg){
 
 void updaterank(float* dest, float defaultvalue, linkmapcsr* map, float* rankvec, threadval* val){
 	int i, j;
-	pthread_t thread[GEM5_NUMPROCS];
-	updatestruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	updatestruct structs[S4_MAX_NUMPROCS];
 	float* destp=dest;
 
 	if(N<GEM5_NUMPROCS){
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			structs[i].dest=destp;
 			structs[i].map=map;
 			structs[i].rankvec=rankvec;
@@ -183,7 +184,7 @@ void updaterank(float* dest, float defaultvalue, linkmapcsr* map, float* rankvec
 			pthread_create(&thread[i], NULL, updaterankfunc, (void*)&structs[i]);
 			destp++;
 		}
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
@@ -208,7 +209,7 @@ int main(){
 	FILE* mapinput=fopen("csrmap", "rb");
 	FILE* output=fopen("threadvalcsr", "wb");
 
-	threadval tval[GEM5_NUMPROCS];
+	threadval tval[S4_MAX_NUMPROCS];
 	
 	linkmapcsr mapcsr;
 	
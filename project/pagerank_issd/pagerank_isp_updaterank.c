@@ -2,13 +2,14 @@
 #include <stdlib.h>
 #include <time.h>
 #include <pthread.h>
+#include "s4.h"
 
 #define N 7115
 #define damp 0.85
 
 #define ERROR 0.000001
 
-#define GEM5_NUMPROCS 4
+#define GEM5_NUMPROCS s4_numprocs()
 
 typedef struct linkmapcsrvalue{
 	int col;
@@ -28,13 +29,102 @@ typedef struct threadval{
 
 typedef struct updatestruct{
 	float* dest;
-	linkmapcsr* map;
-	float* rankvec;
+	const linkmapcsr* map;
+	const float* rankvec;
+	const unsigned short* rankvec16;
 	int num;
 	int k;
 	float defaultvalue;
 }updatestruct;
 
+// rank vector storage precision, selected by the first program argument.
+// fp16/bf16 halve the rank file and the rankvec gathers, sums stay in fp32.
+// fp64acc keeps fp32 storage and accumulates in double for large graphs.
+#define PREC_FP32 0
+#define PREC_FP16 1
+#define PREC_BF16 2
+#define PREC_FP64ACC 3
+
+int rankprec=PREC_FP32;
+
+typedef union floatbits{
+	float f;
+	unsigned int u;
+}floatbits;
+
+unsigned short floattohalf(float f){
+	floatbits v;
+	unsigned int sign, mant, half, rem, halfway;
+	int exp, shift;
+	v.f=f;
+	sign=(v.u>>16)&0x8000;
+	exp=(int)((v.u>>23)&0xFF);
+	mant=v.u&0x7FFFFF;
+	if(exp==0xFF)
+		return sign|0x7C00|(mant?0x200:0);
+	exp=exp-127+15;
+	if(exp>=0x1F)
+		return sign|0x7C00;
+	if(exp<=0){
+		if(exp<-10)
+			return sign;
+		mant|=0x800000;
+		shift=14-exp;
+		half=mant>>shift;
+		rem=mant&((1u<<shift)-1);
+		halfway=1u<<(shift-1);
+		if(rem>halfway||(rem==halfway&&(half&1)))
+			half++;
+		return sign|half;
+	}
+	half=((unsigned int)exp<<10)|(mant>>13);
+	rem=mant&0x1FFF;
+	if(rem>0x1000||(rem==0x1000&&(half&1)))
+		half++;
+	return sign|half;
+}
+
+float halftofloat(unsigned short h){
+	floatbits v;
+	unsigned int sign=((unsigned int)h&0x8000)<<16;
+	unsigned int exp=(h>>10)&0x1F;
+	unsigned int mant=h&0x3FF;
+	int e;
+	if(exp!=0&&exp!=0x1F){
+		v.u=sign|((exp+112)<<23)|(mant<<13);
+	}
+	else if(exp==0x1F){
+		v.u=sign|0x7F800000|(mant<<13);
+	}
+	else if(mant==0){
+		v.u=sign;
+	}
+	else{
+		e=1;
+		while(!(mant&0x400)){
+			mant<<=1;
+			e--;
+		}
+		mant&=0x3FF;
+		v.u=sign|((unsigned int)(e+112)<<23)|(mant<<13);
+	}
+	return v.f;
+}
+
+unsigned short floattobf16(float f){
+	floatbits v;
+	v.f=f;
+	if((v.u&0x7FFFFFFF)>0x7F800000)
+		return (unsigned short)((v.u>>16)|0x40);
+	return (unsigned short)((v.u+0x7FFF+((v.u>>16)&1))>>16);
+}
+
+float bf16tofloat(unsigned short h){
+	floatbits v;
+	v.u=(unsigned int)h<<16;
+	return v.f;
+}
+
 void savethreadval(threadval* dest, FILE* fp){
 	fwrite(dest, sizeof(threadval), GEM5_NUMPROCS, fp);
 }
@@ -52,11 +142,41 @@ void loadmap(linkmapcsr* dest, FILE* fp){
 }
 
 void saverank(float* dest, FILE* fp){
-	fwrite(dest, sizeof(float), N, fp);
+	unsigned short half[N];
+	int i;
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16){
+		for(i=0;i<N;i++){
+			if(rankprec==PREC_FP16)
+				half[i]=floattohalf(dest[i]);
+			else
+				half[i]=floattobf16(dest[i]);
+		}
+		s4_fwrite(half, sizeof(unsigned short), N, fp);
+	}
+	else{
+		s4_fwrite(dest, sizeof(float), N, fp);
+	}
 }
 
 void loadrank(float* dest, FILE* fp){
-	fread(dest, sizeof(float), N, fp);
+	unsigned short half[N];
+	int i;
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16){
+		fread(half, sizeof(unsigned short), N, fp);
+		for(i=0;i<N;i++){
+			if(rankprec==PREC_FP16)
+				dest[i]=halftofloat(half[i]);
+			else
+				dest[i]=bf16tofloat(half[i]);
+		}
+	}
+	else{
+		fread(dest, sizeof(float), N, fp);
+	}
+}
+
+void loadrank16(unsigned short* dest, FILE* fp){
+	fread(dest, sizeof(unsigned short), N, fp);
 }
 
 void genrank0(float* dest){
@@ -132,7 +252,7 @@ void setthreadval(threadval* val, linkmapcsr* map){
 	int i, j=0, count=0;
 	int rest=N%(GEM5_NUMPROCS-1);
 	if(N<GEM5_NUMPROCS){
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			val[i].count=i;
 			val[i].num=1;
 		}
@@ -166,36 +286,80 @@ void* updaterankfunc(void* thearg){
 	}
 }
 
-void updaterank(float* dest, float defaultvalue, linkmapcsr* map, float* rankvec, threadval* val){
+// gathers 16-bit ranks and widens them in registers, sums stay in fp32
+void* updaterankfunc16(void* thearg){
+	updatestruct* arg=(updatestruct*)thearg;
+	int i, j;
+	float val;
+	for(i=0;i<arg->num;i++){
+		val=arg->defaultvalue;
+
+		if(rankprec==PREC_BF16){
+			for(j=arg->map->rownum[arg->k+i];j<arg->map->rownum[arg->k+i+1];j++){
+				val+=arg->map->value[j].value*bf16tofloat(arg->rankvec16[arg->map->value[j].col]);
+			}
+		}
+		else{
+			for(j=arg->map->rownum[arg->k+i];j<arg->map->rownum[arg->k+i+1];j++){
+				val+=arg->map->value[j].value*halftofloat(arg->rankvec16[arg->map->value[j].col]);
+			}
+		}
+		arg->dest[i]=damp*val+(1.0-damp);
+	}
+}
+
+void* updaterankfunc64(void* thearg){
+	updatestruct* arg=(updatestruct*)thearg;
+	int i, j;
+	double val;
+	for(i=0;i<arg->num;i++){
+		val=arg->defaultvalue;
+
+		for(j=arg->map->rownum[arg->k+i];j<arg->map->rownum[arg->k+i+1];j++){
+			val+=(double)arg->map->value[j].value*arg->rankvec[arg->map->value[j].col];
+		}
+		arg->dest[i]=damp*val+(1.0-damp);
+	}
+}
+
+void updaterank(float* dest, float defaultvalue, const linkmapcsr* map, const float* rankvec, const unsigned short* rankvec16, threadval* val){
 	int i, j;
-	pthread_t thread[GEM5_NUMPROCS];
-	updatestruct structs[GEM5_NUMPROCS];
+	pthread_t thread[S4_MAX_NUMPROCS];
+	updatestruct structs[S4_MAX_NUMPROCS];
 	float* destp=dest;
+	void* (*func)(void*)=updaterankfunc;
+
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16)
+		func=updaterankfunc16;
+	else if(rankprec==PREC_FP64ACC)
+		func=updaterankfunc64;
 
 	if(N<GEM5_NUMPROCS){
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			structs[i].dest=destp;
 			structs[i].map=map;
 			structs[i].rankvec=rankvec;
+			structs[i].rankvec16=rankvec16;
 			structs[i].num=val[i].num;
 			structs[i].k=val[i].count;
 			structs[i].defaultvalue=defaultvalue;
-			pthread_create(&thread[i], NULL, updaterankfunc, (void*)&structs[i]);
+			pthread_create(&thread[i], NULL, func, (void*)&structs[i]);
 			destp++;
 		}
-		for(i=0;i<N;i++){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
 			pthread_join(thread[i], NULL);
 		}
 	}
 	else{
 		for(i=0;i<GEM5_NUMPROCS-1;i++){
 			structs[i].rankvec=rankvec;
+			structs[i].rankvec16=rankvec16;
 			structs[i].map=map;
 			structs[i].dest=destp;
 			structs[i].k=val[i].count;
 			structs[i].defaultvalue=defaultvalue;
 			structs[i].num=val[i].num;
-			pthread_create(&thread[i], NULL, updaterankfunc, (void*)&structs[i]);
+			pthread_create(&thread[i], NULL, func, (void*)&structs[i]);
 			destp=destp+structs[i].num;
 		}
 		for(i=0;i<GEM5_NUMPROCS-1;i++){
@@ -204,35 +368,52 @@ void updaterank(float* dest, float defaultvalue, linkmapcsr* map, float* rankvec
 	}
 }
 
-int main(){
-	FILE* mapinput=fopen("csrmap", "rb");
-	FILE* rankinput=fopen("rankcsr", "rb");
+int main(int argc, char* argv[]){
+	FILE* mapinput=s4_fopen("csrmap", "rb");
+	FILE* rankinput=s4_fopen("rankcsr", "rb");
 	FILE* threadinput=fopen("threadvalcsr", "rb");
 	FILE* defvalinput=fopen("defrankcsr", "rb");
-	FILE* rankoutput=fopen("rankcsrupdate", "wb");
+	FILE* rankoutput=s4_fopen("rankcsrupdate", "wb");
 	
-	float prev[N];
+	const float* prev=NULL;
+	const unsigned short* prev16=NULL;
 	float next[N];
 	float defval;
 	
-	threadval tval[GEM5_NUMPROCS];
+	threadval tval[S4_MAX_NUMPROCS];
 	
-	linkmapcsr mapcsr;
+	// the map and the rank vector are used in place, not copied to the stack
+	const linkmapcsr* mapcsr;
 	
-	loadmap(&mapcsr, mapinput);
-	loadrank(prev, rankinput);
+	if(argc>1)
+		rankprec=atoi(argv[1]);
+	
+	s4_init_simulation();
+	mapcsr=(const linkmapcsr*)s4_map(mapinput, 0, sizeof(linkmapcsr));
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16)
+		prev16=(const unsigned short*)s4_map(rankinput, 0, sizeof(unsigned short)*N);
+	else
+		prev=(const float*)s4_map(rankinput, 0, sizeof(float)*N);
+	if(mapcsr==NULL||(prev==NULL&&prev16==NULL)){
+		printf("cannot map csrmap or rankcsr\n");
+		return 1;
+	}
 	loadthreadval(tval, threadinput);
 	fread(&defval, sizeof(float), 1, defvalinput);
 	
-	updaterank(next, defval, &mapcsr, prev, tval);
+	updaterank(next, defval, mapcsr, prev, prev16, tval);
 	
 	saverank(next, rankoutput);
 
-	fclose(mapinput);
+	s4_unmap(mapcsr);
+	s4_unmap(prev);
+	s4_unmap(prev16);
+	s4_fclose(mapinput);
 	fclose(threadinput);
 	fclose(defvalinput);
-	fclose(rankinput);
-	fclose(rankoutput);
+	s4_fclose(rankinput);
+	s4_fclose(rankoutput);
+	s4_wrapup_simulation();
 	
 	return 0;
 }
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include "s4.h"
+
+#define N 7115
+#define damp 0.85
+
+#define GEM5_NUMPROCS s4_numprocs()
+
+// compressed csr : column ids are gap-encoded as varints per row,
+// edge values are rebuilt from the out-degree of the source column.
+#define CSRZ_MAX_BYTES (103689*5)
+
+typedef struct linkmapcsrz{
+	int outnumzero[1005];
+	int outdeg[N];
+	int rowbyte[N+1];
+	int nbytes;
+	unsigned char col[CSRZ_MAX_BYTES];
+}linkmapcsrz;
+
+typedef struct threadval{
+	int num;
+	int count;
+}threadval;
+
+typedef struct updatestruct{
+	float* dest;
+	const linkmapcsrz* map;
+	const unsigned char* col;
+	float* rankvec;
+	const unsigned short* rankvec16;
+	const float* invdeg;
+	int num;
+	int k;
+	float defaultvalue;
+}updatestruct;
+
+// rank vector storage precision, selected by the first program argument.
+// fp16/bf16 halve the rank file and the rankvec gathers, sums stay in fp32.
+// fp64acc keeps fp32 storage and accumulates in double for large graphs.
+#define PREC_FP32 0
+#define PREC_FP16 1
+#define PREC_BF16 2
+#define PREC_FP64ACC 3
+
+int rankprec=PREC_FP32;
+
+typedef union floatbits{
+	float f;
+	unsigned int u;
+}floatbits;
+
+unsigned short floattohalf(float f){
+	floatbits v;
+	unsigned int sign, mant, half, rem, halfway;
+	int exp, shift;
+	v.f=f;
+	sign=(v.u>>16)&0x8000;
+	exp=(int)((v.u>>23)&0xFF);
+	mant=v.u&0x7FFFFF;
+	if(exp==0xFF)
+		return sign|0x7C00|(mant?0x200:0);
+	exp=exp-127+15;
+	if(exp>=0x1F)
+		return sign|0x7C00;
+	if(exp<=0){
+		if(exp<-10)
+			return sign;
+		mant|=0x800000;
+		shift=14-exp;
+		half=mant>>shift;
+		rem=mant&((1u<<shift)-1);
+		halfway=1u<<(shift-1);
+		if(rem>halfway||(rem==halfway&&(half&1)))
+			half++;
+		return sign|half;
+	}
+	half=((unsigned int)exp<<10)|(mant>>13);
+	rem=mant&0x1FFF;
+	if(rem>0x1000||(rem==0x1000&&(half&1)))
+		half++;
+	return sign|half;
+}
+
+float halftofloat(unsigned short h){
+	floatbits v;
+	unsigned int sign=((unsigned int)h&0x8000)<<16;
+	unsigned int exp=(h>>10)&0x1F;
+	unsigned int mant=h&0x3FF;
+	int e;
+	if(exp!=0&&exp!=0x1F){
+		v.u=sign|((exp+112)<<23)|(mant<<13);
+	}
+	else if(exp==0x1F){
+		v.u=sign|0x7F800000|(mant<<13);
+	}
+	else if(mant==0){
+		v.u=sign;
+	}
+	else{
+		e=1;
+		while(!(mant&0x400)){
+			mant<<=1;
+			e--;
+		}
+		mant&=0x3FF;
+		v.u=sign|((unsigned int)(e+112)<<23)|(mant<<13);
+	}
+	return v.f;
+}
+
+unsigned short floattobf16(float f){
+	floatbits v;
+	v.f=f;
+	if((v.u&0x7FFFFFFF)>0x7F800000)
+		return (unsigned short)((v.u>>16)|0x40);
+	return (unsigned short)((v.u+0x7FFF+((v.u>>16)&1))>>16);
+}
+
+float bf16tofloat(unsigned short h){
+	floatbits v;
+	v.u=(unsigned int)h<<16;
+	return v.f;
+}
+
+void loadthreadval(threadval* dest, FILE* fp){
+	fread(dest, sizeof(threadval), GEM5_NUMPROCS, fp);
+}
+
+void saverank(float* dest, FILE* fp){
+	unsigned short half[N];
+	int i;
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16){
+		for(i=0;i<N;i++){
+			if(rankprec==PREC_FP16)
+				half[i]=floattohalf(dest[i]);
+			else
+				half[i]=floattobf16(dest[i]);
+		}
+		s4_fwrite(half, sizeof(unsigned short), N, fp);
+	}
+	else{
+		s4_fwrite(dest, sizeof(float), N, fp);
+	}
+}
+
+void loadrank(float* dest, FILE* fp){
+	s4_fread(dest, sizeof(float), N, fp);
+}
+
+void loadrank16(unsigned short* dest, FILE* fp){
+	s4_fread(dest, sizeof(unsigned short), N, fp);
+}
+
+// rankvec holds rank[col]/outdeg[col] already, so the decoded column id
+// is the only per-edge load left in the inner loop.
+void* updaterankfunc(void* thearg){
+	updatestruct* arg=(updatestruct*)thearg;
+	int i, col, gap, shift;
+	const unsigned char* p;
+	const unsigned char* end;
+	float val;
+	for(i=0;i<arg->num;i++){
+		val=arg->defaultvalue;
+
+		p=&arg->col[arg->map->rowbyte[arg->k+i]];
+		end=&arg->col[arg->map->rowbyte[arg->k+i+1]];
+		col=0;
+		while(p<end){
+			gap=*p&0x7F;
+			shift=7;
+			while(*p++&0x80){
+				gap|=(*p&0x7F)<<shift;
+				shift+=7;
+			}
+			col+=gap;
+			val+=arg->rankvec[col];
+		}
+		arg->dest[i]=damp*val+(1.0-damp);
+	}
+}
+
+// same decode, the 16-bit ranks are widened and scaled by 1/outdeg in fp32,
+// so a gathered contribution is rounded once, when the rank was stored
+void* updaterankfunc16(void* thearg){
+	updatestruct* arg=(updatestruct*)thearg;
+	int i, col, gap, shift;
+	const unsigned char* p;
+	const unsigned char* end;
+	float val;
+	for(i=0;i<arg->num;i++){
+		val=arg->defaultvalue;
+
+		p=&arg->col[arg->map->rowbyte[arg->k+i]];
+		end=&arg->col[arg->map->rowbyte[arg->k+i+1]];
+		col=0;
+		while(p<end){
+			gap=*p&0x7F;
+			shift=7;
+			while(*p++&0x80){
+				gap|=(*p&0x7F)<<shift;
+				shift+=7;
+			}
+			col+=gap;
+			if(rankprec==PREC_BF16)
+				val+=arg->invdeg[col]*bf16tofloat(arg->rankvec16[col]);
+			else
+				val+=arg->invdeg[col]*halftofloat(arg->rankvec16[col]);
+		}
+		arg->dest[i]=damp*val+(1.0-damp);
+	}
+}
+
+void* updaterankfunc64(void* thearg){
+	updatestruct* arg=(updatestruct*)thearg;
+	int i, col, gap, shift;
+	const unsigned char* p;
+	const unsigned char* end;
+	double val;
+	for(i=0;i<arg->num;i++){
+		val=arg->defaultvalue;
+
+		p=&arg->col[arg->map->rowbyte[arg->k+i]];
+		end=&arg->col[arg->map->rowbyte[arg->k+i+1]];
+		col=0;
+		while(p<end){
+			gap=*p&0x7F;
+			shift=7;
+			while(*p++&0x80){
+				gap|=(*p&0x7F)<<shift;
+				shift+=7;
+			}
+			col+=gap;
+			val+=arg->rankvec[col];
+		}
+		arg->dest[i]=damp*val+(1.0-damp);
+	}
+}
+
+void updaterank(float* dest, float defaultvalue, const linkmapcsrz* map, const unsigned char* col, float* rankvec, const unsigned short* rankvec16, threadval* val){
+	int i, j;
+	pthread_t thread[S4_MAX_NUMPROCS];
+	updatestruct structs[S4_MAX_NUMPROCS];
+	float* destp=dest;
+	// 1/outdeg in fp32. a 16-bit rank scaled and stored back in 16 bits would be
+	// rounded twice, and the small ranks of high out-degree nodes go subnormal in fp16
+	static float invdeg[N];
+	void* (*func)(void*)=updaterankfunc;
+
+	for(i=0;i<N;i++){
+		invdeg[i]=map->outdeg[i]!=0 ? 1.0/(float)map->outdeg[i] : 1.0f;
+	}
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16){
+		func=updaterankfunc16;
+	}
+	else{
+		// fold 1/outdeg into the fp32 rank vector once instead of once per edge
+		if(rankprec==PREC_FP64ACC)
+			func=updaterankfunc64;
+		for(i=0;i<N;i++){
+			rankvec[i]=invdeg[i]*rankvec[i];
+		}
+	}
+
+	if(N<GEM5_NUMPROCS){
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
+			structs[i].dest=destp;
+			structs[i].map=map;
+			structs[i].col=col;
+			structs[i].rankvec=rankvec;
+			structs[i].rankvec16=rankvec16;
+			structs[i].invdeg=invdeg;
+			structs[i].num=val[i].num;
+			structs[i].k=val[i].count;
+			structs[i].defaultvalue=defaultvalue;
+			pthread_create(&thread[i], NULL, func, (void*)&structs[i]);
+			destp++;
+		}
+		for(i=0;i<N && i<S4_MAX_NUMPROCS;i++){
+			pthread_join(thread[i], NULL);
+		}
+	}
+	else{
+		for(i=0;i<GEM5_NUMPROCS-1;i++){
+			structs[i].rankvec=rankvec;
+			structs[i].rankvec16=rankvec16;
+			structs[i].invdeg=invdeg;
+			structs[i].map=map;
+			structs[i].col=col;
+			structs[i].dest=destp;
+			structs[i].k=val[i].count;
+			structs[i].defaultvalue=defaultvalue;
+			structs[i].num=val[i].num;
+			pthread_create(&thread[i], NULL, func, (void*)&structs[i]);
+			destp=destp+structs[i].num;
+		}
+		for(i=0;i<GEM5_NUMPROCS-1;i++){
+			pthread_join(thread[i], NULL);
+		}
+	}
+}
+
+int main(int argc, char* argv[]){
+	FILE* mapinput=s4_fopen("csrmapz", "rb");
+	FILE* rankinput=s4_fopen("rankcsr", "rb");
+	FILE* threadinput=fopen("threadvalcsr", "rb");
+	FILE* defvalinput=fopen("defrankcsr", "rb");
+	FILE* rankoutput=s4_fopen("rankcsrupdate", "wb");
+	
+	float prev[N];
+	unsigned short prev16[N];
+	float next[N];
+	float defval;
+	
+	threadval tval[S4_MAX_NUMPROCS];
+	
+	// the map is used in place: a view of the fixed size head, whose col member
+	// is not touched, and a view of the nbytes varint column bytes after it
+	const linkmapcsrz* mapcsr;
+	const unsigned char* mapcol=NULL;
+	
+	if(argc>1)
+		rankprec=atoi(argv[1]);
+	
+	s4_init_simulation();
+	mapcsr=(const linkmapcsrz*)s4_map(mapinput, 0, offsetof(linkmapcsrz, col));
+	if(mapcsr!=NULL)
+		mapcol=(const unsigned char*)s4_map(mapinput, offsetof(linkmapcsrz, col), mapcsr->nbytes);
+	if(mapcsr==NULL||mapcol==NULL){
+		printf("cannot map csrmapz\n");
+		return 1;
+	}
+	if(rankprec==PREC_FP16||rankprec==PREC_BF16)
+		loadrank16(prev16, rankinput);
+	else
+		loadrank(prev, rankinput);
+	loadthreadval(tval, threadinput);
+	fread(&defval, sizeof(float), 1, defvalinput);
+	
+	updaterank(next, defval, mapcsr, mapcol, prev, prev16, tval);
+	
+	saverank(next, rankoutput);
+
+	s4_unmap(mapcol);
+	s4_unmap(mapcsr);
+	s4_fclose(mapinput);
+	fclose(threadinput);
+	fclose(defvalinput);
+	s4_fclose(rankinput);
+	s4_fclose(rankoutput);
+	s4_wrapup_simulation();
+	
+	return 0;
+}
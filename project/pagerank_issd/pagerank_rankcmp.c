@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define N 7115
+#define TOPK 100
+
+// rank vector storage precision, same numbering as the isp stages
+#define PREC_FP32 0
+#define PREC_FP16 1
+#define PREC_BF16 2
+#define PREC_FP64ACC 3
+
+typedef union floatbits{
+	float f;
+	unsigned int u;
+}floatbits;
+
+float halftofloat(unsigned short h){
+	floatbits v;
+	unsigned int sign=((unsigned int)h&0x8000)<<16;
+	unsigned int exp=(h>>10)&0x1F;
+	unsigned int mant=h&0x3FF;
+	int e;
+	if(exp!=0&&exp!=0x1F){
+		v.u=sign|((exp+112)<<23)|(mant<<13);
+	}
+	else if(exp==0x1F){
+		v.u=sign|0x7F800000|(mant<<13);
+	}
+	else if(mant==0){
+		v.u=sign;
+	}
+	else{
+		e=1;
+		while(!(mant&0x400)){
+			mant<<=1;
+			e--;
+		}
+		mant&=0x3FF;
+		v.u=sign|((unsigned int)(e+112)<<23)|(mant<<13);
+	}
+	return v.f;
+}
+
+float bf16tofloat(unsigned short h){
+	floatbits v;
+	v.u=(unsigned int)h<<16;
+	return v.f;
+}
+
+const char* precname[]={"fp32", "fp16", "bf16", "fp64acc"};
+
+void loadrank(float* dest, int prec, FILE* fp){
+	unsigned short half[N];
+	int i;
+	if(prec==PREC_FP16||prec==PREC_BF16){
+		fread(half, sizeof(unsigned short), N, fp);
+		for(i=0;i<N;i++){
+			if(prec==PREC_FP16)
+				dest[i]=halftofloat(half[i]);
+			else
+				dest[i]=bf16tofloat(half[i]);
+		}
+	}
+	else{
+		fread(dest, sizeof(float), N, fp);
+	}
+}
+
+// returns the first converged iteration (1-based) of a rankconv log, 0 if none
+int loadconv(FILE* fp, int* iters, float* lastdiff){
+	float diff;
+	int flag;
+	int first=0;
+	*iters=0;
+	*lastdiff=0.0f;
+	if(fp==NULL)
+		return 0;
+	while(fscanf(fp, "%e %d", &diff, &flag)==2){
+		(*iters)++;
+		*lastdiff=diff;
+		if(flag==1&&first==0)
+			first=*iters;
+	}
+	return first;
+}
+
+void topk(float* rank, int* dest){
+	int i, j, k;
+	for(k=0;k<TOPK;k++){
+		dest[k]=-1;
+		for(i=0;i<N;i++){
+			for(j=0;j<k;j++){
+				if(dest[j]==i)
+					break;
+			}
+			if(j<k)
+				continue;
+			if(dest[k]<0||rank[i]>rank[dest[k]])
+				dest[k]=i;
+		}
+	}
+}
+
+int main(int argc, char* argv[]){
+	float base[N];
+	float rank[N];
+	int basetop[TOPK], ranktop[TOPK];
+	int prec, i, j, overlap=0;
+	int baseiters, rankiters, baseconv, rankconv;
+	float baselast, ranklast;
+	double err, rel, maxabs=0.0, maxrel=0.0, sumrel=0.0, l1=0.0, l1base=0.0;
+	FILE* fp;
+
+	if(argc<6){
+		printf("usage : %s baserank baseconv rank conv precision\n", argv[0]);
+		return 1;
+	}
+	prec=atoi(argv[5]);
+
+	fp=fopen(argv[1], "rb");
+	loadrank(base, PREC_FP32, fp);
+	fclose(fp);
+	fp=fopen(argv[3], "rb");
+	loadrank(rank, prec, fp);
+	fclose(fp);
+
+	fp=fopen(argv[2], "r");
+	baseconv=loadconv(fp, &baseiters, &baselast);
+	if(fp)
+		fclose(fp);
+	fp=fopen(argv[4], "r");
+	rankconv=loadconv(fp, &rankiters, &ranklast);
+	if(fp)
+		fclose(fp);
+
+	for(i=0;i<N;i++){
+		err=fabs((double)rank[i]-(double)base[i]);
+		rel=err/fabs((double)base[i]);
+		if(err>maxabs)
+			maxabs=err;
+		if(rel>maxrel)
+			maxrel=rel;
+		sumrel+=rel;
+		l1+=err;
+		l1base+=fabs((double)base[i]);
+	}
+	topk(base, basetop);
+	topk(rank, ranktop);
+	for(i=0;i<TOPK;i++){
+		for(j=0;j<TOPK;j++){
+			if(basetop[i]==ranktop[j]){
+				overlap++;
+				break;
+			}
+		}
+	}
+
+	printf("precision %s vs fp32\n", precname[prec]);
+	printf("converged at iteration %d of %d (fp32 : %d of %d)\n", rankconv, rankiters, baseconv, baseiters);
+	printf("last max rank change %e (fp32 : %e)\n", ranklast, baselast);
+	printf("max abs error %e\n", maxabs);
+	printf("max rel error %e\n", maxrel);
+	printf("mean rel error %e\n", sumrel/N);
+	printf("l1 rel error %e\n", l1/l1base);
+	printf("top %d overlap %d\n", TOPK, overlap);
+	return 0;
+}
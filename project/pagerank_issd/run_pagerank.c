@@ -1,9 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "isp.h"
+#include "isp_stats.h"
 
 #define issd_clock 400
 #define issd_numcpu 4
+// 1 : run updaterank on the delta+varint compressed map (csrmapz)
+#define csr_compressed 1
+// rank vector precision : 0 fp32, 1 fp16 or 2 bf16 storage with fp32 sums,
+// 3 fp32 storage with double sums. non-fp32 runs are compared against the
+// fp32 result of the same configuration (rankcsr_<cpu>_<clock>).
+#define rank_precision 0
 
 int main(int argc, const char* argv[])
 {
@@ -17,41 +24,72 @@ int main(int argc, const char* argv[])
 	char cmd[128];
 	char pname[32];
 	char funcname[32];
+	char precarg[16];
+	char report[512];
+	const char* precname[]={"fp32", "fp16", "bf16", "fp64acc"};
 	int numcpu=issd_numcpu;
 	int clock=issd_clock;
+	if(argc>1) numcpu=atoi(argv[1]);
+	if(argc>2) clock=atoi(argv[2]);
+	int prec=rank_precision;
 	sprintf(cpuhz, "%dMHz", clock);
+	sprintf(precarg, "%d", prec);
+	remove("rankconv");
 	sprintf(pname, "./pagerank_isp_setr0");
-	sprintf(cmd, "cp ./m5out/stats.txt ./m5out/pagerank_setr0_%d_%s.txt", numcpu, cpuhz);
-	cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-	system(cmd);
+	sprintf(cmd, "pagerank_setr0_%d_%s", numcpu, cpuhz);
+	cycle = ispRunBinaryFileEx(device, pname, precarg, "output.txt", numcpu, cpuhz);
+	ispStatsCollect(cmd);
+	if(csr_compressed){
+		sprintf(pname, "./pagerank_isp_compresscsr");
+		sprintf(cmd, "pagerank_compresscsr_%d_%s", numcpu, cpuhz);
+		cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
+		ispStatsCollect(cmd);
+	}
 	for(i=0;i<28;i++){
 		sprintf(pname, "./pagerank_isp_calcendrank");
-		sprintf(cmd, "cp ./m5out/stats.txt ./m5out/pagerank_calcendrank_%d_%s_%d.txt", numcpu, cpuhz, i+1);
+		sprintf(cmd, "pagerank_calcendrank_%d_%s_%d", numcpu, cpuhz, i+1);
 
-		cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-		system(cmd);
+		cycle = ispRunBinaryFileEx(device, pname, precarg, "output.txt", numcpu, cpuhz);
+		ispStatsCollect(cmd);
 
 		sprintf(pname, "./pagerank_isp_setthreadval");
-		sprintf(cmd, "cp ./m5out/stats.txt ./m5out/pagerank_setthreadval_%d_%s_%d.txt", numcpu, cpuhz, i+1);
+		sprintf(cmd, "pagerank_setthreadval_%d_%s_%d", numcpu, cpuhz, i+1);
 		cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-		system(cmd);
+		ispStatsCollect(cmd);
 
-		sprintf(pname, "./pagerank_isp_updaterank");
-		sprintf(cmd, "cp ./m5out/stats.txt ./m5out/pagerank_updaterank_%d_%s_%d.txt", numcpu, cpuhz, i+1);
-		cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-		system(cmd);
+		if(csr_compressed)
+			sprintf(pname, "./pagerank_isp_updaterankz");
+		else
+			sprintf(pname, "./pagerank_isp_updaterank");
+		sprintf(cmd, "pagerank_updaterank_%d_%s_%d", numcpu, cpuhz, i+1);
+		cycle = ispRunBinaryFileEx(device, pname, precarg, "output.txt", numcpu, cpuhz);
+		ispStatsCollect(cmd);
 
 		sprintf(pname, "./pagerank_isp_checkvec");
-		sprintf(cmd, "cp ./m5out/stats.txt ./m5out/pagerank_checkvec_%d_%s_%d.txt", numcpu, cpuhz, i+1);
-		cycle = ispRunBinaryFileEx(device, pname, NULL, "output.txt", numcpu, cpuhz);
-		system(cmd);
+		sprintf(cmd, "pagerank_checkvec_%d_%s_%d", numcpu, cpuhz, i+1);
+		cycle = ispRunBinaryFileEx(device, pname, precarg, "output.txt", numcpu, cpuhz);
+		ispStatsCollect(cmd);
 
-		system("rm rankcsr");
-		system("cp rankcsrupdate rankcsr");
+		ispCopyFile("rankcsrupdate", "rankcsr");
+	}
+	if(prec==0){
+		sprintf(cmd, "rankcsr_%d_%s", numcpu, cpuhz);
+		ispCopyFile("rankcsr", cmd);
+		sprintf(cmd, "rankconv_%d_%s", numcpu, cpuhz);
+		ispCopyFile("rankconv", cmd);
+	}
+	else{
+		sprintf(cmd, "rankcsr_%d_%s_%s", numcpu, cpuhz, precname[prec]);
+		ispCopyFile("rankcsr", cmd);
+		sprintf(cmd, "rankconv_%d_%s_%s", numcpu, cpuhz, precname[prec]);
+		ispCopyFile("rankconv", cmd);
+		sprintf(report, "./pagerank_rankcmp rankcsr_%d_%s rankconv_%d_%s rankcsr_%d_%s_%s rankconv_%d_%s_%s %d > rankcmp_%d_%s_%s.txt",
+			numcpu, cpuhz, numcpu, cpuhz, numcpu, cpuhz, precname[prec], numcpu, cpuhz, precname[prec], prec, numcpu, cpuhz, precname[prec]);
+		system(report);
 	}
-	sprintf(cmd, "cp rankcsr rankcsr_%d_%s", numcpu, cpuhz);
-	system(cmd);
-	system("rm rankcsr");
-	printf("ISP cycle = %d\n", cycle);
+	remove("rankcsr");
+	sprintf(cmd, "./m5out/pagerank_stats_%d_%s.csv", numcpu, cpuhz);
+	ispStatsWrite(cmd);
+	printf("ISP cycle = %lld\n", ispStatsTotalTicks());
 return 0;
 }
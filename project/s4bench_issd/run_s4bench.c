@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "isp.h"
+#include "isp_stats.h"
+
+#define issd_clock 400
+#define issd_numcpu 1
+#define bench_pages 4096
+#define bench_work 64
+
+// prefetch depths to compare, 0 is the synchronous s4_fread scan
+int depths[]={0, 1, 2, 4, 8, 16};
+
+void makeinput(int pages){
+	FILE* ofp=fopen("s4benchinput", "wb");
+	int i;
+	for(i=0;i<pages*1024;i++)
+		fputc(rand()&0xff, ofp);
+	fclose(ofp);
+}
+
+int main(int argc, const char* argv[])
+{
+	isp_device_id device;
+	int cycle;
+	long long hidden;
+	int i;
+	int pages=bench_pages;
+	int work=bench_work;
+	char str1[1024];
+	char args[64];
+	char cpuhz[16];
+	int numcpu=issd_numcpu;
+	int clock=issd_clock;
+	if(argc>1) pages=atoi(argv[1]);
+	if(argc>2) work=atoi(argv[2]);
+	sprintf(cpuhz, "%dMHz", clock);
+
+	makeinput(pages);
+	for(i=0;i<sizeof(depths)/sizeof(depths[0]);i++){
+		sprintf(args, "%d %d", depths[i], work);
+		cycle = ispRunBinaryFileEx(device, "./s4bench_isp_scan", args, "output.txt", numcpu, cpuhz);
+		sprintf(str1, "io_stat_depth_%d.txt", depths[i]);
+		ispCopyFile("io_stat.txt", str1);
+		hidden=0;
+		ispStatsReadValue(str1, "s4.prefetch_hidden_ticks", &hidden);
+		sprintf(str1, "s4bench_scan_%d_%s_%d", numcpu, cpuhz, depths[i]);
+		ispStatsCollect(str1);
+		printf("depth %d: ISP cycle = %d, hidden flash ticks = %lld\n", depths[i], cycle, hidden);
+	}
+	sprintf(str1, "./m5out/s4bench_stats_%d_%s.csv", numcpu, cpuhz);
+	ispStatsWrite(str1);
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "s4.h"
+
+// sequential scan of s4benchinput, one page at a time.
+// depth 0 reads with s4_fread, otherwise up to depth pages are prefetched ahead of the page in use.
+#define DEPTH 4
+#define WORK 64
+
+unsigned int pagesum(const char* page, size_t n, int work){
+	unsigned int sum=0;
+	size_t i;
+	int w;
+	for(w=0;w<work;w++)
+		for(i=0;i<n;i++)
+			sum=sum*31+(unsigned char)page[i];
+	return sum;
+}
+
+int main(int argc, char* argv[]){
+	int depth=DEPTH;
+	int work=WORK;
+	char page[S4_PAGE_SIZE];
+	int slot[S4_NUM_BUFFERS];
+	unsigned int sum=0;
+	size_t n;
+	long npages, p;
+	FILE* fp;
+	char* buf;
+
+	if(argc>1) depth=atoi(argv[1]);
+	if(argc>2) work=atoi(argv[2]);
+	if(depth>S4_NUM_BUFFERS) depth=S4_NUM_BUFFERS;
+
+	s4_init_simulation();
+	fp=s4_fopen("s4benchinput", "rb");
+	if(fp==NULL){
+		printf("no s4benchinput\n");
+		return 1;
+	}
+	s4_fseek(fp, 0, SEEK_END);
+	npages=(ftell(fp)+S4_PAGE_SIZE-1)/S4_PAGE_SIZE;
+	s4_rewind(fp);
+
+	if(depth<=0){
+		for(p=0;p<npages;p++){
+			n=s4_fread(page, sizeof(char), S4_PAGE_SIZE, fp);
+			sum+=pagesum(page, n, work);
+		}
+	}
+	else{
+		for(p=0;p<npages && p<depth;p++)
+			slot[p]=s4_prefetch(fp, p);
+		for(p=0;p<npages;p++){
+			buf=s4_wait_page(slot[p%depth], &n);
+			if(buf) sum+=pagesum(buf, n, work);
+			s4_release_page(slot[p%depth]);
+			if(p+depth<npages)
+				slot[p%depth]=s4_prefetch(fp, p+depth);
+		}
+	}
+	s4_fclose(fp);
+	printf("depth %d pages %ld checksum %u\n", depth, npages, sum);
+	s4_wrapup_simulation();
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "isp.h"
+
+// callback latency and throughput of isp_socket.c against the local s4dev.
+//
+//   run_callbench [handler threads] [calls] [bytes] [window]
+//   run_callbench 1,2,4,8 20000 64 32
+//
+// for every handler thread count a fresh host process connects, runs a stream of
+// fast callbacks and then the same stream with every fourth call a slow one,
+// to show whether slow callbacks hold up the fast ones. the slow calls sleep
+// slow_usec each, calls/4 of them on one handler thread is the floor of that run.
+
+#define bench_calls 20000
+#define bench_bytes 64
+#define bench_window 32
+#define slow_usec 1000
+
+int threads[64]={1, 2, 4, 8};
+int numthreads=4;
+
+void fastcallback(isp_device_id device, void* data, int* size){
+	// echo the value back, the device measures the round trip
+}
+
+void slowcallback(isp_device_id device, void* data, int* size){
+	usleep(slow_usec);
+}
+
+void printmessage(char* message){
+	printf("  %s\n", message);
+}
+
+int runbench(int nthreads, int calls, int bytes, int window){
+	isp_device_id device;
+	isp_uint num;
+	char script[256];
+	int i;
+	ispSetCallbackThreads(nthreads);
+	// the device may still be starting
+	for(i=0;i<50 && !ispGetDeviceIDs(NULL, ISP_DEVICE_TYPE_STORAGE, 1, &device, &num);i++)
+		usleep(100000);
+	if(i==50) return 1;
+	ispRegisterCallbackFunction(device, "bench", "fast", fastcallback);
+	ispRegisterCallbackFunction(device, "bench", "slow", slowcallback);
+
+	printf("%d handler threads, %d calls of %d bytes, %d outstanding\n", nthreads, calls, bytes, window);
+	sprintf(script, "callback %d %d %d bench_fast", calls, bytes, window);
+	ispAddScript(device, script);
+	ispRunScript(device, 1, printmessage);
+
+	// the same count with a slow callback every fourth call
+	ispClearScript(device);
+	sprintf(script, "callback %d %d %d bench_fast bench_fast bench_fast bench_slow", calls, bytes, window);
+	ispAddScript(device, script);
+	ispRunScript(device, 1, printmessage);
+	ispExit(device);
+	return 0;
+}
+
+int main(int argc, const char* argv[])
+{
+	char buffer[256];
+	char* item;
+	int calls=bench_calls;
+	int bytes=bench_bytes;
+	int window=bench_window;
+	int i, status;
+	pid_t device, host;
+	if(argc>1){
+		strncpy(buffer, argv[1], sizeof(buffer)-1);
+		buffer[sizeof(buffer)-1]=0;
+		numthreads=0;
+		for(item=strtok(buffer, ","); item && numthreads<64; item=strtok(NULL, ","))
+			threads[numthreads++]=atoi(item);
+	}
+	if(argc>2) calls=atoi(argv[2]);
+	if(argc>3) bytes=atoi(argv[3]);
+	if(argc>4) window=atoi(argv[4]);
+
+	device=fork();
+	if(device==0){
+		execl("./s4dev", "s4dev", (char*)NULL);
+		printf("cannot start ./s4dev\n");
+		_exit(1);
+	}
+
+	// one process per configuration, the handler threads are fixed at connect time
+	for(i=0;i<numthreads;i++){
+		fflush(stdout);
+		host=fork();
+		if(host==0)
+			exit(runbench(threads[i], calls, bytes, window));
+		waitpid(host, &status, 0);
+	}
+
+	kill(device, SIGTERM);
+	waitpid(device, &status, 0);
+	return 0;
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "isp.h"
+
+// concurrent load on the local s4dev through isp_socket.c.
+//
+//   run_s4load [clients] [commands] [callbacks] [bytes] [window]
+//   run_s4load 1,2,4,8 2000 5000 64 16
+//
+// every client is a process with its own device connection. it times command round
+// trips (ispClearScript), then runs a callback stream and an s4_fread stream on the
+// device, whose latencies the device measures and prints. the sums and worst cases
+// over the clients go to s4load.csv.
+
+#define load_commands 2000
+#define load_callbacks 5000
+#define load_bytes 64
+#define load_window 16
+#define load_read_bytes 4096
+#define load_input_pages 1024
+
+int clients[64]={1, 2, 4, 8};
+int numclients=4;
+
+// device measured results of one client
+typedef struct loadresult{
+	double commands;	// per second
+	double callbacks;	// per second
+	double callback_avg;	// us
+	double callback_p99;
+	double read_mbps;
+	double read_p99;
+}loadresult;
+
+loadresult result;
+
+double seconds(){
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec+t.tv_usec*1e-6;
+}
+
+void echocallback(isp_device_id device, void* data, int* size){
+}
+
+// "<name>: N calls, R calls/s[, M MB/s], avg A us, p50 B us, p99 C us, max D us"
+void parseresult(char* message){
+	double rate=0, mbps=0, avg=0, p50=0, p99=0;
+	char* p=strstr(message, "calls, ");
+	if(p) sscanf(p, "calls, %lf", &rate);
+	if((p=strstr(message, "calls/s, "))) sscanf(p, "calls/s, %lf MB/s", &mbps);
+	if((p=strstr(message, "avg "))) sscanf(p, "avg %lf us, p50 %lf us, p99 %lf", &avg, &p50, &p99);
+	if(strncmp(message, "bench_echo:", 11)==0){
+		result.callbacks=rate;
+		result.callback_avg=avg;
+		result.callback_p99=p99;
+	}
+	else if(strncmp(message, "fread ", 6)==0){
+		result.read_mbps=mbps;
+		result.read_p99=p99;
+	}
+	else
+		printf("  %s\n", message);
+}
+
+int runclient(int fd, int commands, int callbacks, int bytes, int window){
+	isp_device_id device;
+	isp_uint num;
+	char script[256];
+	double begin;
+	int i;
+	for(i=0;i<50 && !ispGetDeviceIDs(NULL, ISP_DEVICE_TYPE_STORAGE, 1, &device, &num);i++)
+		usleep(100000);
+	if(i==50) return 1;
+	ispRegisterCallbackFunction(device, "bench", "echo", echocallback);
+
+	begin=seconds();
+	for(i=0;i<commands;i++)
+		ispClearScript(device);
+	result.commands=commands/(seconds()-begin);
+
+	sprintf(script, "callback %d %d %d bench_echo", callbacks, bytes, window);
+	ispAddScript(device, script);
+	sprintf(script, "fread s4loadinput %d %d %d", load_read_bytes, callbacks/4, window);
+	ispAddScript(device, script);
+	ispRunScript(device, 1, parseresult);
+	ispExit(device);
+
+	write(fd, &result, sizeof(result));
+	return 0;
+}
+
+// the byte s4dev expects at an offset of a file it reads: byte offset%8 of the
+// little endian 64-bit word offset/8
+unsigned char patternbyte(long long offset){
+	return (unsigned char)((unsigned long long)(offset>>3)>>((offset&7)*8));
+}
+
+void makeinput(){
+	FILE* ofp=fopen("s4loadinput", "wb");
+	int i;
+	for(i=0;i<load_input_pages*1024;i++)
+		fputc(patternbyte(i), ofp);
+	fclose(ofp);
+}
+
+int main(int argc, const char* argv[])
+{
+	char buffer[256];
+	char* item;
+	int commands=load_commands;
+	int callbacks=load_callbacks;
+	int bytes=load_bytes;
+	int window=load_window;
+	int i, j, status, pipefd[2];
+	pid_t device;
+	FILE* ofp;
+	if(argc>1){
+		strncpy(buffer, argv[1], sizeof(buffer)-1);
+		buffer[sizeof(buffer)-1]=0;
+		numclients=0;
+		for(item=strtok(buffer, ","); item && numclients<64; item=strtok(NULL, ","))
+			clients[numclients++]=atoi(item);
+	}
+	if(argc>2) commands=atoi(argv[2]);
+	if(argc>3) callbacks=atoi(argv[3]);
+	if(argc>4) bytes=atoi(argv[4]);
+	if(argc>5) window=atoi(argv[5]);
+
+	makeinput();
+	device=fork();
+	if(device==0){
+		execl("./s4dev", "s4dev", (char*)NULL);
+		printf("cannot start ./s4dev\n");
+		_exit(1);
+	}
+
+	ofp=fopen("s4load.csv", "w");
+	fprintf(ofp, "clients,commands_per_sec,callbacks_per_sec,callback_avg_us,callback_p99_us,read_mb_per_sec,read_p99_us\n");
+	printf("%7s %12s %12s %10s %10s %10s %10s\n", "clients", "commands/s", "callbacks/s", "cb avg us", "cb p99 us", "read MB/s", "rd p99 us");
+	for(i=0;i<numclients;i++){
+		loadresult total, one;
+		int got=0;
+		memset(&total, 0, sizeof(total));
+		pipe(pipefd);
+		fflush(stdout);
+		fflush(ofp);
+		for(j=0;j<clients[i];j++){
+			if(fork()==0){
+				close(pipefd[0]);
+				exit(runclient(pipefd[1], commands, callbacks, bytes, window));
+			}
+		}
+		close(pipefd[1]);
+		// rates add up over the clients, latencies are the mean average and the worst p99
+		while(read(pipefd[0], &one, sizeof(one))==sizeof(one)){
+			total.commands+=one.commands;
+			total.callbacks+=one.callbacks;
+			total.callback_avg+=one.callback_avg;
+			if(one.callback_p99>total.callback_p99) total.callback_p99=one.callback_p99;
+			total.read_mbps+=one.read_mbps;
+			if(one.read_p99>total.read_p99) total.read_p99=one.read_p99;
+			got++;
+		}
+		close(pipefd[0]);
+		for(j=0;j<clients[i];j++)
+			wait(&status);
+		if(got) total.callback_avg/=got;
+		if(got<clients[i]) printf("%d of %d clients failed\n", clients[i]-got, clients[i]);
+
+		printf("%7d %12.0f %12.0f %10.1f %10.1f %10.1f %10.1f\n", clients[i], total.commands, total.callbacks, total.callback_avg, total.callback_p99, total.read_mbps, total.read_p99);
+		fprintf(ofp, "%d,%.0f,%.0f,%.1f,%.1f,%.1f,%.1f\n", clients[i], total.commands, total.callbacks, total.callback_avg, total.callback_p99, total.read_mbps, total.read_p99);
+	}
+	fclose(ofp);
+
+	kill(device, SIGTERM);
+	waitpid(device, &status, 0);
+	return 0;
+}
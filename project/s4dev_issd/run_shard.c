@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "isp.h"
+
+// sharding one input over several devices.
+//
+//   run_shard [device counts] [megabytes] [bytes] [window] [usec]
+//   run_shard 1,2,4 64 65536 16 200
+//
+// starts one s4dev per device on ports 5000 and up. for every device count the input
+// is split into that many shards and every device runs the same script on its own
+// shard, from one host thread per device: it reads the shard through s4_fread, checks
+// every read against the pattern at its offset, sums the bytes and sends progress
+// callbacks. the shard sums must add up to the sum of the input, and every callback
+// must arrive with the id of the device that sent it.
+// usec is the device time per read, the part that sharding spreads over the drives.
+
+#define shard_base_port 5000
+#define shard_megabytes 64
+#define shard_bytes 65536
+#define shard_window 16
+#define shard_usec 200
+#define shard_callbacks 200
+#define MAX_SHARDS 16
+
+int counts[MAX_SHARDS]={1, 2, 4};
+int numcounts=3;
+
+typedef struct shard{
+	isp_device_id device;
+	char file[64];
+	long long size;
+	int bytes, window, usec;
+	unsigned long long sum;		// reported by the device
+	int status;
+}shard;
+
+// the shard of the calling thread, for printresult
+__thread shard* myshard;
+
+// progress callbacks by device id
+int progress[64];
+
+double seconds(){
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec+t.tv_usec*1e-6;
+}
+
+void progresscallback(isp_device_id device, void* data, int* size){
+	if(device>0 && device<64)
+		__sync_fetch_and_add(&progress[device], 1);
+}
+
+void printresult(char* message){
+	char* p=strstr(message, ", sum ");
+	if(strncmp(message, "fread ", 6)==0 && p)
+		sscanf(p, ", sum %llu", &myshard->sum);
+	else if(strncmp(message, "shard_progress:", 15)!=0)
+		printf("  device %d: %s\n", myshard->device, message);
+}
+
+void* runshard(void* data){
+	char script[256];
+	myshard=(shard*)data;
+	ispClearScript(myshard->device);
+	ispRegisterCallbackFunction(myshard->device, "shard", "progress", progresscallback);
+	sprintf(script, "callback %d 16 8 shard_progress", shard_callbacks);
+	ispAddScript(myshard->device, script);
+	sprintf(script, "fread %s %d %lld %d %d", myshard->file, myshard->bytes, (myshard->size+myshard->bytes-1)/myshard->bytes, myshard->window, myshard->usec);
+	ispAddScript(myshard->device, script);
+	myshard->status=ispRunScript(myshard->device, 1, printresult);
+	return NULL;
+}
+
+// the byte s4dev expects at an offset of a file it reads: byte offset%8 of the
+// little endian 64-bit word offset/8
+unsigned char patternbyte(long long offset){
+	return (unsigned char)((unsigned long long)(offset>>3)>>((offset&7)*8));
+}
+
+// split the input into n shards of whole reads, returns the byte sum of the input
+unsigned long long makeshards(shard* shards, int n, long long size, int bytes){
+	unsigned long long sum=0;
+	long long per=(size/n+bytes-1)/bytes*bytes;
+	long long left=size;
+	long long c;
+	int i;
+	FILE* ofp;
+	for(i=0;i<n;i++){
+		sprintf(shards[i].file, "shard%d_%d.dat", n, i);
+		shards[i].size=left<per ? left : per;
+		left-=shards[i].size;
+		ofp=fopen(shards[i].file, "wb");
+		for(c=0;c<shards[i].size;c++){
+			int value=patternbyte(c);
+			fputc(value, ofp);
+			sum+=value;
+		}
+		fclose(ofp);
+	}
+	return sum;
+}
+
+// connect to the first n devices, the servers may still be starting
+int opendevices(shard* shards, int n){
+	isp_device_id devices[MAX_SHARDS];
+	isp_uint num=0;
+	char addresses[256]="";
+	int i, try;
+	for(i=0;i<n;i++)
+		sprintf(addresses+strlen(addresses), "%s%d", i ? "," : "", shard_base_port+i);
+	ispSetDeviceAddresses(addresses);
+	for(try=0;try<50;try++){
+		ispGetDeviceIDs(NULL, ISP_DEVICE_TYPE_STORAGE, n, devices, &num);
+		if((int)num==n) break;
+		for(i=0;i<(int)num;i++)
+			ispExit(devices[i]);
+		usleep(100000);
+	}
+	if((int)num<n) return 0;
+	for(i=0;i<n;i++)
+		shards[i].device=devices[i];
+	return 1;
+}
+
+int main(int argc, const char* argv[])
+{
+	char buffer[256], port[16];
+	char* item;
+	long long size=(long long)shard_megabytes<<20;
+	int bytes=shard_bytes;
+	int window=shard_window;
+	int usec=shard_usec;
+	int maxcount=0, i, j, status;
+	pid_t servers[MAX_SHARDS];
+	shard shards[MAX_SHARDS];
+	pthread_t threads[MAX_SHARDS];
+	FILE* ofp;
+	if(argc>1){
+		strncpy(buffer, argv[1], sizeof(buffer)-1);
+		buffer[sizeof(buffer)-1]=0;
+		numcounts=0;
+		for(item=strtok(buffer, ","); item && numcounts<MAX_SHARDS; item=strtok(NULL, ","))
+			if(atoi(item)>0 && atoi(item)<=MAX_SHARDS) counts[numcounts++]=atoi(item);
+	}
+	if(argc>2) size=(long long)atoi(argv[2])<<20;
+	if(argc>3) bytes=atoi(argv[3]);
+	if(argc>4) window=atoi(argv[4]);
+	if(argc>5) usec=atoi(argv[5]);
+	for(i=0;i<numcounts;i++)
+		if(counts[i]>maxcount) maxcount=counts[i];
+
+	for(i=0;i<maxcount;i++){
+		servers[i]=fork();
+		if(servers[i]==0){
+			sprintf(port, "%d", shard_base_port+i);
+			execl("./s4dev", "s4dev", port, (char*)NULL);
+			printf("cannot start ./s4dev\n");
+			_exit(1);
+		}
+	}
+
+	ofp=fopen("shard.csv", "w");
+	fprintf(ofp, "devices,megabytes,seconds,mb_per_sec,speedup,correct\n");
+	printf("%7s %10s %10s %10s %8s\n", "devices", "seconds", "MB/s", "speedup", "correct");
+	double base=0;
+	for(i=0;i<numcounts;i++){
+		int n=counts[i], correct=1;
+		unsigned long long sum=0, expected;
+		double begin, elapsed;
+		memset(shards, 0, sizeof(shards));
+		memset(progress, 0, sizeof(progress));
+		expected=makeshards(shards, n, size, bytes);
+		if(!opendevices(shards, n)){
+			printf("cannot open %d devices\n", n);
+			break;
+		}
+
+		// the same script on every device at once
+		begin=seconds();
+		for(j=0;j<n;j++){
+			shards[j].bytes=bytes;
+			shards[j].window=window;
+			shards[j].usec=usec;
+			pthread_create(&threads[j], NULL, runshard, &shards[j]);
+		}
+		for(j=0;j<n;j++)
+			pthread_join(threads[j], NULL);
+		elapsed=seconds()-begin;
+
+		for(j=0;j<n;j++){
+			sum+=shards[j].sum;
+			if(!shards[j].status || progress[shards[j].device]!=shard_callbacks){
+				printf("  device %d: status %d, %d of %d callbacks\n", shards[j].device, shards[j].status, progress[shards[j].device], shard_callbacks);
+				correct=0;
+			}
+			ispExit(shards[j].device);
+			remove(shards[j].file);
+		}
+		if(sum!=expected){
+			printf("  sum %llu, expected %llu\n", sum, expected);
+			correct=0;
+		}
+		if(base==0) base=elapsed;
+
+		printf("%7d %10.3f %10.1f %10.2f %8s\n", n, elapsed, size/elapsed/1e6, base/elapsed, correct ? "yes" : "no");
+		fprintf(ofp, "%d,%lld,%.3f,%.1f,%.2f,%d\n", n, size>>20, elapsed, size/elapsed/1e6, base/elapsed, correct);
+	}
+	fclose(ofp);
+
+	for(i=0;i<maxcount;i++){
+		kill(servers[i], SIGTERM);
+		waitpid(servers[i], &status, 0);
+	}
+	return 0;
+}
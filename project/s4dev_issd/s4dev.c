@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "isp_proto.h"
+
+// local stand-in for the S4 device side of isp_socket.c.
+// it listens on 127.0.0.1:<port> (5000) and serves every connected host in its own
+// thread; the two sockets of a host are paired by the token of their hello messages.
+//
+//   s4dev [port]
+//
+// scripts are lines of
+//   print <text>
+//   callback <count> <bytes> <window> <node_func>...
+//   fread <host file> <bytes> <count> <window> [usec]
+// callback sends count receive callbacks with a bytes long value, at most window
+// outstanding, round robin over the listed functions. fread opens a file on the host
+// with s4_fopen and reads it with count s4_fread calls of bytes each, starting over
+// at the end of the file, and sums the bytes it read as a stand-in kernel. the file
+// must hold patternbyte(offset) at every offset, every read is checked against the
+// offset it was sent for, so a reply with the bytes of another read fails the script.
+// usec is the device time spent on every read, to model the flash and core of one drive.
+// both print calls/s and round trip latencies.
+
+#define MAX_SCRIPT 65536
+#define MAX_NAMES 1024
+#define MAX_BENCH_FUNCS 16
+#define MAX_PENDING 64
+
+typedef struct devname{
+	char name[256];
+	uint32_t id;
+}devname;
+
+typedef struct session{
+	int cmdfd, cbfd;
+	char script[MAX_SCRIPT];
+	int scriptlen;
+	devname names[MAX_NAMES];
+	int numnames;
+	isp_msg msg;		// replies on the callback socket
+}session;
+
+// sockets whose partner has not said hello yet
+typedef struct pending{
+	uint64_t token;
+	int fd[2];
+}pending;
+
+pending pendings[MAX_PENDING];
+int numpendings=0;
+
+double now(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+void sendprint(session* s, const char* text){
+	struct iovec field=ispFieldString(text);
+	ispSendMsg(s->cmdfd, ISP_MSG_PRINT, 0, &field, 1);
+}
+
+void reply(session* s, uint32_t id, uint32_t status){
+	uint32_t statusfield;
+	struct iovec field=ispFieldU32(&statusfield, status);
+	ispSendMsg(s->cmdfd, ISP_MSG_REPLY, id, &field, 1);
+}
+
+int cmpdouble(const void* a, const void* b){
+	double x=*(const double*)a, y=*(const double*)b;
+	return x<y ? -1 : x>y;
+}
+
+uint32_t findid(session* s, const char* name){
+	int i;
+	for(i=0;i<s->numnames;i++)
+		if(strcmp(s->names[i].name, name)==0) return s->names[i].id;
+	return 0;
+}
+
+// send a callback by its registered id, or by node and function name when it has none
+int sendcallback(session* s, const char* name, uint32_t seq, const char* value, int bytes){
+	struct iovec fields[3];
+	uint32_t idfield;
+	char node[256];
+	const char* func;
+	uint32_t id=findid(s, name);
+	if(id){
+		fields[0]=ispFieldU32(&idfield, id);
+		fields[1]=ispFieldData(value, bytes);
+		return ispSendMsg(s->cbfd, ISP_MSG_CALLBACK_RECEIVE, seq, fields, 2);
+	}
+	func=strchr(name, '_');
+	if(func==NULL) return -1;
+	snprintf(node, sizeof(node), "%.*s", (int)(func-name), name);
+	fields[0]=ispFieldString(node);
+	fields[1]=ispFieldString(func+1);
+	fields[2]=ispFieldData(value, bytes);
+	return ispSendMsg(s->cbfd, ISP_MSG_CALLBACK_RECEIVE, seq, fields, 3);
+}
+
+// s4_fopen(file, "rb") on the host, returns the handle or 0
+uint32_t hostopen(session* s, const char* file){
+	struct iovec fields[2];
+	fields[0]=ispFieldString(file);
+	fields[1]=ispFieldString("rb");
+	if(ispSendMsg(s->cbfd, ISP_MSG_S4_FOPEN, 0, fields, 2)!=0) return 0;
+	while(ispRecvMsg(s->cbfd, &s->msg)>0)
+		if(s->msg.type==ISP_MSG_REPLY && s->msg.request_id==0)
+			return ispMsgU32(&s->msg, 0)==0 ? ispMsgU32(&s->msg, 1) : 0;
+	return 0;
+}
+
+void hostclose(session* s, uint32_t handle){
+	uint32_t handlefield;
+	struct iovec field=ispFieldU32(&handlefield, handle);
+	if(ispSendMsg(s->cbfd, ISP_MSG_S4_FCLOSE, 0, &field, 1)!=0) return;
+	while(ispRecvMsg(s->cbfd, &s->msg)>0)
+		if(s->msg.type==ISP_MSG_REPLY && s->msg.request_id==0) return;
+}
+
+int hostread(session* s, uint32_t seq, uint32_t handle, int bytes){
+	uint64_t sizefield, nitemsfield;
+	uint32_t handlefield;
+	struct iovec fields[3];
+	fields[0]=ispFieldU64(&sizefield, 1);
+	fields[1]=ispFieldU64(&nitemsfield, bytes);
+	fields[2]=ispFieldU32(&handlefield, handle);
+	return ispSendMsg(s->cbfd, ISP_MSG_S4_FREAD, seq, fields, 3);
+}
+
+void printlatency(session* s, const char* name, double* lat, int n, double seconds, long long bytes, const char* extra){
+	char line[512];
+	char rate[64]="";
+	double sum=0;
+	int i;
+	if(n==0) return;
+	for(i=0;i<n;i++) sum+=lat[i];
+	qsort(lat, n, sizeof(double), cmpdouble);
+	if(bytes>=0) sprintf(rate, ", %.1f MB/s", bytes/seconds/1e6);
+	snprintf(line, sizeof(line), "%s: %d calls, %.0f calls/s%s, avg %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us%s",
+		name, n, n/seconds, rate, sum/n*1e6, lat[n/2]*1e6, lat[(int)(n*0.99)]*1e6, lat[n-1]*1e6, extra);
+	sendprint(s, line);
+}
+
+int runcallbacks(session* s, char* args){
+	char* funcs[MAX_BENCH_FUNCS];
+	int func[MAX_BENCH_FUNCS];	// listed function -> first listing of the same name
+	int numfuncs=0, count, bytes, window, n;
+	int sent=0, done=0, failed=0, i;
+	double* start;
+	double* lat[MAX_BENCH_FUNCS];
+	int numlat[MAX_BENCH_FUNCS]={0,};
+	double begin, seconds;
+	char* value;
+	char* tok;
+	char* save;
+	if(sscanf(args, "%d %d %d%n", &count, &bytes, &window, &n)<3 || count<=0) return 1;
+	for(tok=strtok_r(args+n, " \t", &save); tok && numfuncs<MAX_BENCH_FUNCS; tok=strtok_r(NULL, " \t", &save))
+		funcs[numfuncs++]=tok;
+	if(numfuncs==0) return 1;
+	if(window<1) window=1;
+	for(i=0;i<numfuncs;i++)
+		for(func[i]=0;strcmp(funcs[func[i]], funcs[i]);func[i]++);
+
+	value=(char*)calloc(bytes>0 ? bytes : 1, 1);
+	start=(double*)malloc(sizeof(double)*count);
+	for(i=0;i<numfuncs;i++)
+		lat[i]=(double*)malloc(sizeof(double)*count);
+
+	begin=now();
+	while(done<count){
+		while(sent<count && sent-done<window){
+			start[sent]=now();
+			if(sendcallback(s, funcs[sent%numfuncs], sent, value, bytes)!=0) break;
+			sent++;
+		}
+		if(ispRecvMsg(s->cbfd, &s->msg)<=0) break;
+		if(s->msg.type!=ISP_MSG_REPLY || s->msg.request_id>=(uint32_t)sent) continue;
+		if(ispMsgU32(&s->msg, 0)!=0) failed++;
+		i=func[s->msg.request_id%numfuncs];
+		lat[i][numlat[i]++]=now()-start[s->msg.request_id];
+		done++;
+	}
+	seconds=now()-begin;
+
+	for(i=0;i<numfuncs;i++)
+		printlatency(s, funcs[i], lat[i], numlat[i], seconds, -1, "");
+	if(failed){
+		char line[128];
+		sprintf(line, "%d callbacks were not registered on the host", failed);
+		sendprint(s, line);
+	}
+
+	for(i=0;i<numfuncs;i++)
+		free(lat[i]);
+	free(start);
+	free(value);
+	return done<count || failed;
+}
+
+// byte offset%8 of the little endian 64-bit word offset/8, every word holds its index
+unsigned char patternbyte(long long offset){
+	return (unsigned char)((unsigned long long)(offset>>3)>>((offset&7)*8));
+}
+
+int runfreads(session* s, char* args){
+	char file[1024], name[1100], extra[64];
+	int bytes, count, window, usec=0;
+	int sent=0, done=0, eof=0;
+	uint32_t handle, i, seq;
+	long long total=0, pos=0, bad=0, firstbad=-1;
+	unsigned long long sum=0;
+	long long* offset;
+	double* start;
+	double* lat;
+	double begin, seconds;
+	if(sscanf(args, "%1023s %d %d %d %d", file, &bytes, &count, &window, &usec)<4 || count<=0 || bytes<=0) return 1;
+	if(window<1) window=1;
+	snprintf(name, sizeof(name), "fread %s", file);
+	handle=hostopen(s, file);
+	if(handle==0){
+		snprintf(name, sizeof(name), "cannot open %s on the host", file);
+		sendprint(s, name);
+		return 1;
+	}
+
+	// request ids start at 1, 0 is for the open and close calls
+	start=(double*)malloc(sizeof(double)*(count+1));
+	offset=(long long*)malloc(sizeof(long long)*(count+1));
+	lat=(double*)malloc(sizeof(double)*count);
+	begin=now();
+	while(done<count){
+		while(!eof && sent<count && sent-done<window){
+			sent++;
+			start[sent]=now();
+			offset[sent]=pos;
+			pos+=bytes;
+			if(hostread(s, sent, handle, bytes)!=0) break;
+		}
+		if(ispRecvMsg(s->cbfd, &s->msg)<=0) break;
+		if(s->msg.type!=ISP_MSG_REPLY || s->msg.request_id==0 || s->msg.request_id>(uint32_t)sent) continue;
+		seq=s->msg.request_id;
+		lat[done++]=now()-start[seq];
+		if(s->msg.num_fields>1 && s->msg.field_length[1]>0){
+			total+=s->msg.field_length[1];
+			for(i=0;i<s->msg.field_length[1];i++){
+				sum+=(unsigned char)s->msg.field[1][i];
+				if((unsigned char)s->msg.field[1][i]!=patternbyte(offset[seq]+i)){
+					if(firstbad<0) firstbad=offset[seq]+i;
+					bad++;
+				}
+			}
+			if(usec>0) usleep(usec);
+		}
+		else
+			eof=1;
+		// at the end of the file wait for the reads in flight and open it again
+		if(eof && sent==done){
+			hostclose(s, handle);
+			handle=hostopen(s, file);
+			if(handle==0) break;
+			eof=0;
+			pos=0;
+		}
+	}
+	seconds=now()-begin;
+	if(handle) hostclose(s, handle);
+
+	sprintf(extra, ", sum %llu", sum);
+	printlatency(s, name, lat, done, seconds, total, extra);
+	if(bad){
+		snprintf(name, sizeof(name), "%s: %lld bytes differ from the pattern, the first at offset %lld", file, bad, firstbad);
+		sendprint(s, name);
+	}
+	free(start);
+	free(offset);
+	free(lat);
+	return done<count || bad;
+}
+
+int runscript(session* s){
+	char line[4096];
+	const char* p;
+	int status=0, n;
+	for(p=s->script; *p; p+=n){
+		n=strcspn(p, "\n");
+		snprintf(line, sizeof(line), "%.*s", n, p);
+		if(p[n]) n++;
+		if(strncmp(line, "print ", 6)==0)
+			sendprint(s, line+6);
+		else if(strncmp(line, "callback ", 9)==0)
+			status|=runcallbacks(s, line+9);
+		else if(strncmp(line, "fread ", 6)==0)
+			status|=runfreads(s, line+6);
+		else if(line[0] && line[0]!='#')
+			status=1;
+	}
+	return status;
+}
+
+void* serve(void* data){
+	session* s=(session*)data;
+	isp_msg msg;
+	char node[128], func[128];
+	int type;
+	memset(&msg, 0, sizeof(msg));
+	while((type=ispRecvMsg(s->cmdfd, &msg))>0){
+		if(type==ISP_MSG_ADD_SCRIPT){
+			int n=msg.num_fields>0 ? msg.field_length[0] : 0;
+			if(s->scriptlen+n+2>MAX_SCRIPT){
+				reply(s, msg.request_id, 1);
+				continue;
+			}
+			memcpy(s->script+s->scriptlen, msg.field[0], n);
+			s->scriptlen+=n;
+			s->script[s->scriptlen++]='\n';
+			s->script[s->scriptlen]=0;
+			reply(s, msg.request_id, 0);
+		}
+		else if(type==ISP_MSG_CLEAR_SCRIPT){
+			s->scriptlen=0;
+			s->script[0]=0;
+			reply(s, msg.request_id, 0);
+		}
+		else if(type==ISP_MSG_RUN_SCRIPT){
+			reply(s, msg.request_id, runscript(s));
+		}
+		else if(type==ISP_MSG_REGISTER_CALLBACK){
+			devname* d;
+			ispMsgString(&msg, 0, node, sizeof(node));
+			ispMsgString(&msg, 1, func, sizeof(func));
+			if(s->numnames>=MAX_NAMES){
+				reply(s, msg.request_id, 1);
+				continue;
+			}
+			d=&s->names[s->numnames++];
+			snprintf(d->name, sizeof(d->name), "%s_%s", node, func);
+			d->id=ispMsgU32(&msg, 2);
+			reply(s, msg.request_id, 0);
+		}
+		else if(type==ISP_MSG_EXIT)
+			break;
+		else
+			reply(s, msg.request_id, 1);
+	}
+	ispMsgFree(&msg);
+	ispMsgFree(&s->msg);
+	close(s->cbfd);
+	close(s->cmdfd);
+	free(s);
+	return NULL;
+}
+
+// pair a new socket by the token of its hello, start a session when both are there
+void hello(int fd){
+	isp_msg msg;
+	uint64_t token;
+	int role, i;
+	memset(&msg, 0, sizeof(msg));
+	if(ispRecvMsg(fd, &msg)!=ISP_MSG_HELLO){
+		ispMsgFree(&msg);
+		close(fd);
+		return;
+	}
+	token=ispMsgU64(&msg, 0);
+	role=ispMsgU32(&msg, 1)==ISP_ROLE_CALLBACK;
+	ispMsgFree(&msg);
+
+	for(i=0;i<numpendings && pendings[i].token!=token;i++);
+	if(i==numpendings){
+		if(numpendings==MAX_PENDING){
+			close(fd);
+			return;
+		}
+		pendings[i].token=token;
+		pendings[i].fd[0]=pendings[i].fd[1]=-1;
+		numpendings++;
+	}
+	pendings[i].fd[role]=fd;
+	if(pendings[i].fd[0]>=0 && pendings[i].fd[1]>=0){
+		pthread_t thread;
+		session* s=(session*)calloc(1, sizeof(session));
+		s->cmdfd=pendings[i].fd[0];
+		s->cbfd=pendings[i].fd[1];
+		pendings[i]=pendings[--numpendings];
+		pthread_create(&thread, NULL, serve, s);
+		pthread_detach(thread);
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	struct sockaddr_in addr;
+	int port=5000;
+	int listenfd, fd, one=1;
+	if(argc>1) port=atoi(argv[1]);
+
+	listenfd=socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family=AF_INET;
+	addr.sin_port=htons(port);
+	addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+	if(bind(listenfd, (struct sockaddr*)&addr, sizeof(addr))<0 || listen(listenfd, 128)<0){
+		printf("s4dev: cannot listen on port %d\n", port);
+		return 1;
+	}
+	printf("s4dev: listening on port %d\n", port);
+	fflush(stdout);
+
+	while(1){
+		fd=accept(listenfd, NULL, NULL);
+		if(fd<0) continue;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		hello(fd);
+	}
+	return 0;
+}
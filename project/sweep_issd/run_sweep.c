@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "isp.h"
+#include "isp_stats.h"
+
+// design-space sweep of one isp pipeline over core counts and clocks.
+//
+//   run_sweep <pipeline> <numprocs> <clocks> [max jobs]
+//   run_sweep ../sweep_issd/kmeans.sweep 2,4,8 200,400
+//
+// numprocs and clocks (MHz) are comma separated lists, an item a-b is the range a..b.
+// every configuration runs the whole pipeline in its own directory sweep_<app>/n<numprocs>_<clock>MHz,
+// configurations run in parallel through ispSubmitBinaryFileEx.
+// the pipeline is a text file, paths are relative to the directory run_sweep is started in:
+//   # comment
+//   input <file>                     copied into every configuration directory
+//   stage <name> <binary> [args]     one gem5 run
+//   copy <from> <to>                 host side copy inside the configuration directory
+//   repeat <n> ... end               the enclosed steps n times, stage names get _1.._n
+// the result is sweep_<app>.csv with ticks, speedup and efficiency per configuration,
+// against the fewest cores of the same clock, and sweep_<app>_stages.csv with the stats of every stage.
+
+#define MAX_STEPS 4096
+#define MAX_INPUTS 32
+#define MAX_CONFIGS 256
+#define MAX_REPEAT_DEPTH 8
+
+enum { STEP_STAGE, STEP_COPY };
+typedef struct sweepstep{
+	int type;
+	char name[128];
+	char program[PATH_MAX];
+	char argument[256];
+	char from[PATH_MAX];
+	char to[PATH_MAX];
+}sweepstep;
+
+typedef struct sweepconfig{
+	int numprocs;
+	int clock;
+	char cpuhz[16];
+	char workdir[PATH_MAX];
+	int step;
+	isp_job job;
+	long long ticks;
+	int failed;
+}sweepconfig;
+
+sweepstep steps[MAX_STEPS];
+int numsteps=0;
+char inputs[MAX_INPUTS][PATH_MAX];
+int numinputs=0;
+sweepconfig configs[MAX_CONFIGS];
+int numconfigs=0;
+char app[128];
+
+// read the pipeline, repeat blocks are unrolled here
+int readpipeline(const char* fileName){
+	FILE* ifp=fopen(fileName, "r");
+	char line[1024], word[128];
+	int repeatstart[MAX_REPEAT_DEPTH], repeatcount[MAX_REPEAT_DEPTH];
+	int depth=0, lineno=0;
+	int i, j, k, n, first, count;
+	if(ifp==NULL){
+		printf("cannot open %s\n", fileName);
+		return 0;
+	}
+	while(fgets(line, sizeof(line), ifp)){
+		char* p=line;
+		lineno++;
+		line[strcspn(line, "\r\n#")]=0;
+		if(sscanf(p, "%127s%n", word, &n)<1) continue;
+		p+=n;
+		while(*p==' ' || *p=='\t') p++;
+		if(strcmp(word, "input")==0){
+			if(numinputs>=MAX_INPUTS || sscanf(p, "%s", inputs[numinputs])<1) goto error;
+			numinputs++;
+		}
+		else if(strcmp(word, "stage")==0 || strcmp(word, "copy")==0){
+			sweepstep* s=&steps[numsteps];
+			if(numsteps>=MAX_STEPS) goto error;
+			memset(s, 0, sizeof(sweepstep));
+			if(word[0]=='s'){
+				s->type=STEP_STAGE;
+				if(sscanf(p, "%127s %s%n", s->name, s->program, &n)<2) goto error;
+				p+=n;
+				while(*p==' ' || *p=='\t') p++;
+				strcpy(s->argument, p);
+			}
+			else{
+				s->type=STEP_COPY;
+				if(sscanf(p, "%s %s", s->from, s->to)<2) goto error;
+			}
+			numsteps++;
+		}
+		else if(strcmp(word, "repeat")==0){
+			if(depth>=MAX_REPEAT_DEPTH || sscanf(p, "%d", &repeatcount[depth])<1) goto error;
+			repeatstart[depth++]=numsteps;
+		}
+		else if(strcmp(word, "end")==0){
+			if(depth==0) goto error;
+			depth--;
+			first=repeatstart[depth];
+			count=numsteps-first;
+			if(first+count*repeatcount[depth]>MAX_STEPS) goto error;
+			for(i=1;i<repeatcount[depth];i++)
+				for(j=0;j<count;j++)
+					steps[first+i*count+j]=steps[first+j];
+			numsteps=first+count*(repeatcount[depth]>0 ? repeatcount[depth] : 0);
+			for(i=0;i<repeatcount[depth];i++)
+				for(j=0;j<count;j++){
+					sweepstep* s=&steps[first+i*count+j];
+					if(s->type!=STEP_STAGE) continue;
+					k=strlen(s->name);
+					snprintf(s->name+k, sizeof(s->name)-k, "_%d", i+1);
+				}
+		}
+		else goto error;
+	}
+	fclose(ifp);
+	if(depth!=0){
+		printf("%s: repeat without end\n", fileName);
+		return 0;
+	}
+	return 1;
+error:
+	printf("%s:%d: cannot parse \"%s\"\n", fileName, lineno, line);
+	fclose(ifp);
+	return 0;
+}
+
+// comma separated values, a-b is a range
+int parselist(const char* str, int* values, int max){
+	char buffer[1024];
+	char* item;
+	int n=0, a, b;
+	strncpy(buffer, str, sizeof(buffer)-1);
+	buffer[sizeof(buffer)-1]=0;
+	for(item=strtok(buffer, ","); item; item=strtok(NULL, ",")){
+		if(sscanf(item, "%d-%d", &a, &b)<2) b=a=atoi(item);
+		for(;a<=b && n<max;a++)
+			values[n++]=a;
+	}
+	return n;
+}
+
+void copyinto(sweepconfig* c, const char* from, const char* to){
+	char src[PATH_MAX*2], dst[PATH_MAX*2];
+	snprintf(src, sizeof(src), "%s/%s", c->workdir, from);
+	snprintf(dst, sizeof(dst), "%s/%s", c->workdir, to);
+	ispCopyFile(src, dst);
+}
+
+// run host copies up to the next stage and submit it
+void advance(isp_device_id device, sweepconfig* c){
+	c->job=-1;
+	while(c->step<numsteps && steps[c->step].type==STEP_COPY){
+		copyinto(c, steps[c->step].from, steps[c->step].to);
+		c->step++;
+	}
+	if(c->failed || c->step>=numsteps) return;
+	sweepstep* s=&steps[c->step];
+	c->job=ispSubmitBinaryFileEx(device, c->workdir, s->program, s->argument[0] ? s->argument : NULL, "output.txt", c->numprocs, c->cpuhz);
+	if(c->job<0) c->failed=1;
+}
+
+int main(int argc, const char* argv[])
+{
+	isp_device_id device;
+	int numprocs[MAX_CONFIGS], clocks[MAX_CONFIGS];
+	int numnumprocs, numclocks;
+	int i, j, running;
+	char str1[PATH_MAX*2];
+	char* p;
+	FILE* ofp;
+	if(argc<4){
+		printf("usage: %s <pipeline> <numprocs> <clocks in MHz> [max jobs]\n", argv[0]);
+		return 1;
+	}
+	if(argc>4) ispSetMaxJobs(atoi(argv[4]));
+	if(!readpipeline(argv[1])) return 1;
+	numnumprocs=parselist(argv[2], numprocs, MAX_CONFIGS);
+	numclocks=parselist(argv[3], clocks, MAX_CONFIGS);
+
+	p=strrchr(argv[1], '/');
+	strncpy(app, p ? p+1 : argv[1], sizeof(app)-1);
+	if((p=strchr(app, '.'))) *p=0;
+	sprintf(str1, "sweep_%s", app);
+	mkdir(str1, 0755);
+
+	for(i=0;i<numclocks;i++)
+		for(j=0;j<numnumprocs && numconfigs<MAX_CONFIGS;j++){
+			sweepconfig* c=&configs[numconfigs++];
+			memset(c, 0, sizeof(sweepconfig));
+			c->numprocs=numprocs[j];
+			c->clock=clocks[i];
+			sprintf(c->cpuhz, "%dMHz", c->clock);
+			snprintf(c->workdir, sizeof(c->workdir), "sweep_%s/n%d_%s", app, c->numprocs, c->cpuhz);
+			mkdir(c->workdir, 0755);
+		}
+
+	for(i=0;i<numconfigs;i++){
+		for(j=0;j<numinputs;j++){
+			p=strrchr(inputs[j], '/');
+			snprintf(str1, sizeof(str1), "%s/%s", configs[i].workdir, p ? p+1 : inputs[j]);
+			ispCopyFile(inputs[j], str1);
+		}
+		advance(device, &configs[i]);
+	}
+
+	// every configuration is a chain of dependent stages, the chains run side by side
+	do{
+		running=0;
+		for(i=0;i<numconfigs;i++){
+			sweepconfig* c=&configs[i];
+			if(c->job<0) continue;
+			if(ispPollJob(c->job)!=1){
+				running++;
+				continue;
+			}
+			// a failed stage adds no ticks, the configuration is reported failed
+			if(ispJobStatus(c->job)!=0 || ispJobCycle(c->job)<=0){
+				printf("%s: stage %s failed, status %d\n", c->workdir, steps[c->step].name, ispJobStatus(c->job));
+				c->failed=1;
+			}
+			else
+				c->ticks+=ispJobCycle(c->job);
+			snprintf(str1, sizeof(str1), "%s_%d_%s_%s", app, c->numprocs, c->cpuhz, steps[c->step].name);
+			ispStatsCollectDir(str1, c->workdir);
+			c->step++;
+			advance(device, c);
+			if(c->job>=0) running++;
+		}
+		if(running) usleep(100000);
+	}while(running);
+	ispWaitAllJobs();
+
+	sprintf(str1, "sweep_%s.csv", app);
+	ofp=fopen(str1, "w");
+	fprintf(ofp, "numprocs,clock,ticks,seconds,speedup,efficiency,status\n");
+	printf("%8s %8s %16s %10s %8s %10s\n", "numprocs", "clock", "ticks", "seconds", "speedup", "efficiency");
+	for(i=0;i<numconfigs;i++){
+		sweepconfig* c=&configs[i];
+		sweepconfig* base=NULL;
+		double speedup=0, efficiency=0;
+		for(j=0;j<numconfigs;j++)
+			if(configs[j].clock==c->clock && !configs[j].failed && (base==NULL || configs[j].numprocs<base->numprocs))
+				base=&configs[j];
+		if(base && !c->failed && c->ticks>0){
+			speedup=(double)base->ticks/c->ticks;
+			efficiency=speedup*base->numprocs/c->numprocs;
+		}
+		fprintf(ofp, "%d,%s,%lld,%.6f,%.4f,%.4f,%s\n", c->numprocs, c->cpuhz, c->ticks, c->ticks/1e12, speedup, efficiency, c->failed ? "failed" : "ok");
+		printf("%8d %8s %16lld %10.6f %8.4f %10.4f%s\n", c->numprocs, c->cpuhz, c->ticks, c->ticks/1e12, speedup, efficiency, c->failed ? " failed" : "");
+	}
+	fclose(ofp);
+
+	sprintf(str1, "sweep_%s_stages.csv", app);
+	ispStatsWrite(str1);
+	return 0;
+}
@@ -0,0 +1,179 @@
+// framing of the host <-> S4 device socket protocol, see isp_proto.h
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "isp_proto.h"
+
+static uint64_t hton64(uint64_t value)
+{
+	return ((uint64_t)htonl((uint32_t)value)<<32) | htonl((uint32_t)(value>>32));
+}
+
+static int writeAll(int fd, struct iovec* iov, int count)
+{
+	ssize_t n;
+
+	while(count>0) {
+		n = writev(fd, iov, count);
+		if(n<0 && errno==EINTR) continue;
+		if(n<=0) return -1;
+		// drop what was written, writev may stop anywhere
+		while(count>0 && (size_t)n>=iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if(count>0) {
+			iov->iov_base = (char*)iov->iov_base+n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+static int readAll(int fd, void* buffer, size_t size)
+{
+	ssize_t n;
+	char* p = (char*)buffer;
+
+	while(size>0) {
+		n = read(fd, p, size);
+		if(n<0 && errno==EINTR) continue;
+		if(n<=0) return n<0 ? -1 : 0;
+		p += n;
+		size -= n;
+	}
+	return 1;
+}
+
+int ispSendMsg(int fd, int type, uint32_t request_id, const struct iovec* fields, int num_fields)
+{
+	uint32_t header[4];
+	uint32_t lengths[ISP_MSG_MAX_FIELDS];
+	struct iovec iov[1+2*ISP_MSG_MAX_FIELDS];
+	uint64_t length = 0;
+	int i;
+
+	if(num_fields>ISP_MSG_MAX_FIELDS) return -1;
+	for(i=0; i<num_fields; i++)
+		length += 4+fields[i].iov_len;
+	if(length>ISP_MSG_MAX_LENGTH) return -1;
+
+	header[0] = htonl(ISP_MSG_MAGIC);
+	header[1] = htonl(type);
+	header[2] = htonl(request_id);
+	header[3] = htonl((uint32_t)length);
+	iov[0].iov_base = header;
+	iov[0].iov_len = ISP_MSG_HEADER_SIZE;
+	for(i=0; i<num_fields; i++) {
+		lengths[i] = htonl((uint32_t)fields[i].iov_len);
+		iov[1+2*i].iov_base = &lengths[i];
+		iov[1+2*i].iov_len = 4;
+		iov[2+2*i] = fields[i];
+	}
+	return writeAll(fd, iov, 1+2*num_fields);
+}
+
+int ispRecvMsg(int fd, isp_msg* msg)
+{
+	uint32_t header[4];
+	uint32_t offset, length;
+	int r;
+
+	r = readAll(fd, header, ISP_MSG_HEADER_SIZE);
+	if(r<=0) return r;
+	if(ntohl(header[0])!=ISP_MSG_MAGIC) return -1;
+	msg->type = ntohl(header[1]);
+	msg->request_id = ntohl(header[2]);
+	msg->length = ntohl(header[3]);
+	if(msg->length>ISP_MSG_MAX_LENGTH) return -1;
+
+	if(msg->length>msg->capacity) {
+		char* payload = (char*)realloc(msg->payload, msg->length);
+		if(payload==NULL) return -1;
+		msg->payload = payload;
+		msg->capacity = msg->length;
+	}
+	if(msg->length>0 && readAll(fd, msg->payload, msg->length)<=0) return -1;
+
+	msg->num_fields = 0;
+	for(offset=0; offset+4<=msg->length && msg->num_fields<ISP_MSG_MAX_FIELDS; offset+=length) {
+		memcpy(&length, msg->payload+offset, 4);
+		length = ntohl(length);
+		offset += 4;
+		if(length>msg->length-offset) return -1;
+		msg->field[msg->num_fields] = msg->payload+offset;
+		msg->field_length[msg->num_fields] = length;
+		msg->num_fields++;
+	}
+	return msg->type;
+}
+
+void ispMsgFree(isp_msg* msg)
+{
+	free(msg->payload);
+	memset(msg, 0, sizeof(isp_msg));
+}
+
+uint32_t ispMsgU32(const isp_msg* msg, int index)
+{
+	uint32_t value;
+
+	if(index>=msg->num_fields || msg->field_length[index]!=4) return 0;
+	memcpy(&value, msg->field[index], 4);
+	return ntohl(value);
+}
+
+uint64_t ispMsgU64(const isp_msg* msg, int index)
+{
+	uint64_t value;
+
+	if(index>=msg->num_fields || msg->field_length[index]!=8) return 0;
+	memcpy(&value, msg->field[index], 8);
+	return hton64(value);
+}
+
+const char* ispMsgString(const isp_msg* msg, int index, char* buffer, size_t size)
+{
+	size_t n = 0;
+
+	if(index<msg->num_fields) {
+		n = msg->field_length[index];
+		if(n>size-1) n = size-1;
+		memcpy(buffer, msg->field[index], n);
+	}
+	buffer[n] = 0;
+	return buffer;
+}
+
+struct iovec ispFieldU32(uint32_t* buffer, uint32_t value)
+{
+	*buffer = htonl(value);
+	return ispFieldData(buffer, 4);
+}
+
+struct iovec ispFieldU64(uint64_t* buffer, uint64_t value)
+{
+	*buffer = hton64(value);
+	return ispFieldData(buffer, 8);
+}
+
+struct iovec ispFieldString(const char* value)
+{
+	return ispFieldData(value, strlen(value));
+}
+
+struct iovec ispFieldData(const void* data, size_t size)
+{
+	struct iovec field;
+
+	field.iov_base = (void*)data;
+	field.iov_len = size;
+	return field;
+}
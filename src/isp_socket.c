@@ -1,110 +1,267 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
 
 #include "isp.h"
 #include "s4sim.h"
+#include "isp_stats.h"
+#include "isp_proto.h"
 
 #define BUFF_SIZE 1024
-static char sendBuff[BUFF_SIZE+1];
-static char recvBuff[BUFF_SIZE+1];
-static int sockfd = 0;
-static int callbackfd = 0;
-static pthread_t p_thread;
-void* callbackFunctionHandler(void* data);
 
-int getTickCycle(const char* theFileName);
+// files the device opened on the host with s4_fopen, the handle is the index
+#define MAX_HOST_FILES 256
 
-void sendS4(const char* theString)
+// an open device. the id handed out is the slot in mDevices plus one, so 0 is never a device.
+// calls on one device are serialized by lock, calls on different devices run in parallel.
+#define ISP_MAX_DEVICES 64
+typedef struct {
+	int used;
+	int sockfd;
+	int callbackfd;
+	uint32_t requestId;
+	isp_msg reply;
+	pthread_mutex_t lock;		// held from a request until its reply
+	pthread_mutex_t sendLock;	// handler threads share the callback socket for their replies
+	FILE* hostFiles[MAX_HOST_FILES];
+	pthread_mutex_t hostFileLock;
+	// with mWorkLock: callback messages queued or running, and whether the socket closed
+	int pendingWork;
+	int callbackClosed;
+	// with mWorkLock: file messages run one at a time in the order they arrived,
+	// fileBusy is set while one is queued or running and the rest wait in fileHead
+	int fileBusy;
+	struct CallbackWork* fileHead;
+	struct CallbackWork* fileTail;
+} IspDevice;
+static IspDevice mDevices[ISP_MAX_DEVICES];
+static pthread_mutex_t mDeviceLock = PTHREAD_MUTEX_INITIALIZER;
+
+// the callback sockets of all devices are watched by one epoll thread
+static int mEpollFd = -1;
+static pthread_once_t mCallbackOnce = PTHREAD_ONCE_INIT;
+static void startCallbackDispatch();
+
+static IspDevice* getDevice(isp_device_id device_id)
 {
-	write(sockfd,theString,strlen(theString));
+	if(device_id<1 || device_id>ISP_MAX_DEVICES || !mDevices[device_id-1].used) {
+		printf("\n Error : unknown device %d \n", device_id);
+		return NULL;
+	}
+	return &mDevices[device_id-1];
 }
 
-int receiveS4()
+static isp_device_id deviceID(IspDevice* device)
 {
-	memset(recvBuff,0,sizeof(recvBuff));
-	return read(sockfd, recvBuff, BUFF_SIZE);
+	return (isp_device_id)(device-mDevices)+1;
 }
 
-/* in-storage-processing API's */
-isp_int ispGetDeviceIDs(isp_platform_id platform,
-        isp_device_type device_type,
-        isp_uint num_entries,
-        isp_device_id *devices,
-        isp_uint* num_devices)
+// send a command and wait for its reply. print messages of a running script
+// that arrive meanwhile go to printFunction. returns the reply status, 0 is OK.
+static int requestS4(IspDevice* device, int type, const struct iovec* fields, int num_fields, void(*printFunction)(char* message))
 {
-	// setup socket connection
-	int n = 0;
-	struct sockaddr_in serv_addr; 
+	isp_msg* reply = &device->reply;
+	int status = -1;
 
-	if((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-	{
-		printf("\n Error : Could not create socket \n");
-		return 0;
-	} 
+	pthread_mutex_lock(&device->lock);
+	uint32_t id = ++device->requestId;
+	if(ispSendMsg(device->sockfd, type, id, fields, num_fields)==0) {
+		while(ispRecvMsg(device->sockfd, reply)>0) {
+			if(reply->type==ISP_MSG_PRINT) {
+				if(printFunction && reply->num_fields>0) {
+					char* message = (char*)malloc(reply->field_length[0]+1);
+					ispMsgString(reply, 0, message, reply->field_length[0]+1);
+					printFunction(message);
+					free(message);
+				}
+				continue;
+			}
+			if(reply->type==ISP_MSG_REPLY && reply->request_id==id) {
+				status = (int)ispMsgU32(reply, 0);
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&device->lock);
+	return status;
+}
 
-	if((callbackfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-	{
-		printf("\n Error : Could not create callback socket \n");
+// devices are listed as host:port or port, separated by commas, the default is
+// the one device at 127.0.0.1:5000. ISP_DEVICES overrides it from the environment.
+static char mDeviceAddresses[4096] = "";
+
+void ispSetDeviceAddresses(const char* addresses)
+{
+	snprintf(mDeviceAddresses, sizeof(mDeviceAddresses), "%s", addresses ? addresses : "");
+}
+
+static void freeDevice(IspDevice* device)
+{
+	pthread_mutex_destroy(&device->lock);
+	pthread_mutex_destroy(&device->sendLock);
+	pthread_mutex_destroy(&device->hostFileLock);
+	ispMsgFree(&device->reply);
+	pthread_mutex_lock(&mDeviceLock);
+	device->used = 0;
+	pthread_mutex_unlock(&mDeviceLock);
+}
+
+// open the command and callback sockets of one device, returns its id or 0
+static isp_device_id connectDevice(const char* host, int port)
+{
+	struct sockaddr_in serv_addr; 
+	IspDevice* device = NULL;
+	int i;
+
+	pthread_mutex_lock(&mDeviceLock);
+	for(i=0; i<ISP_MAX_DEVICES; i++) {
+		if(!mDevices[i].used) {
+			device = &mDevices[i];
+			memset(device, 0, sizeof(IspDevice));
+			device->used = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mDeviceLock);
+	if(device==NULL) {
+		printf("\n Error : too many devices \n");
 		return 0;
-	} 
+	}
+	pthread_mutex_init(&device->lock, NULL);
+	pthread_mutex_init(&device->sendLock, NULL);
+	pthread_mutex_init(&device->hostFileLock, NULL);
+	device->sockfd = -1;
+	device->callbackfd = -1;
 
 	memset(&serv_addr, '0', sizeof(serv_addr)); 
-
 	serv_addr.sin_family = AF_INET;
-	serv_addr.sin_port = htons(5000); 
+	serv_addr.sin_port = htons(port); 
+	if(inet_pton(AF_INET, host, &serv_addr.sin_addr)<=0)
+	{
+		printf("\n inet_pton error occured for %s\n", host);
+		goto fail;
+	} 
 
-	if(inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr)<=0)
+	if((device->sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
 	{
-		printf("\n inet_pton error occured\n");
-		return 0;
+		printf("\n Error : Could not create socket \n");
+		goto fail;
 	} 
 
+	if((device->callbackfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+	{
+		printf("\n Error : Could not create callback socket \n");
+		goto fail;
+	} 
 
-	if( connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+	if( connect(device->sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
 	{
-		printf("\n Error : Connect Failed \n");
-		return 0;
+		printf("\n Error : Connect to %s:%d Failed \n", host, port);
+		goto fail;
 	} 
 
-	if( connect(callbackfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+	if( connect(device->callbackfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
 	{
-		printf("\n Error : Callback Connect Failed \n");
-		return 0;
+		printf("\n Error : Callback Connect to %s:%d Failed \n", host, port);
+		goto fail;
 	} 
 
-	// callback function handler thread is starting
-	pthread_create(&p_thread, NULL, callbackFunctionHandler, NULL);
+	// requests and callbacks are small round trips, do not let nagle hold them back
+	int one = 1;
+	setsockopt(device->sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	setsockopt(device->callbackfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
 
-	*devices = (isp_device_id) sockfd;
+	// the same token on both sockets lets a device serving several hosts pair them
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	uint64_t token = ((uint64_t)getpid()<<32) ^ ((uint64_t)now.tv_sec*1000000+now.tv_usec) ^ (uint64_t)device->sockfd;
+	uint64_t tokenField;
+	uint32_t roleField;
+	struct iovec fields[2];
+	fields[0] = ispFieldU64(&tokenField, token);
+	fields[1] = ispFieldU32(&roleField, ISP_ROLE_COMMAND);
+	ispSendMsg(device->sockfd, ISP_MSG_HELLO, ++device->requestId, fields, 2);
+	fields[1] = ispFieldU32(&roleField, ISP_ROLE_CALLBACK);
+	ispSendMsg(device->callbackfd, ISP_MSG_HELLO, ++device->requestId, fields, 2);
 
-	return 1;
+	// hand the callback socket to the dispatch thread
+	struct epoll_event event;
+	pthread_once(&mCallbackOnce, startCallbackDispatch);
+	event.events = EPOLLIN;
+	event.data.ptr = device;
+	epoll_ctl(mEpollFd, EPOLL_CTL_ADD, device->callbackfd, &event);
+
+	return deviceID(device);
+
+fail:
+	if(device->sockfd>=0) close(device->sockfd);
+	if(device->callbackfd>=0) close(device->callbackfd);
+	freeDevice(device);
+	return 0;
+}
+
+/* in-storage-processing API's */
+isp_int ispGetDeviceIDs(isp_platform_id platform,
+        isp_device_type device_type,
+        isp_uint num_entries,
+        isp_device_id *devices,
+        isp_uint* num_devices)
+{
+	char addresses[sizeof(mDeviceAddresses)], host[64];
+	char* item;
+	char* save;
+	char* colon;
+	isp_uint n = 0;
+
+	if(mDeviceAddresses[0]==0) {
+		const char* value = getenv("ISP_DEVICES");
+		ispSetDeviceAddresses(value && value[0] ? value : "127.0.0.1:5000");
+	}
+	strcpy(addresses, mDeviceAddresses);
+
+	// setup socket connections, one pair per device
+	for(item=strtok_r(addresses, ", ", &save); item && n<num_entries; item=strtok_r(NULL, ", ", &save)) {
+		isp_device_id id;
+		colon = strchr(item, ':');
+		if(colon) {
+			snprintf(host, sizeof(host), "%.*s", (int)(colon-item), item);
+			id = connectDevice(host, atoi(colon+1));
+		} else
+			id = connectDevice("127.0.0.1", atoi(item));
+		if(id) devices[n++] = id;
+	}
+	if(num_devices) *num_devices = n;
+
+	return n>0;
 }
 
 // download a script string to a storage. It is appended to the existing scripts
 isp_int ispAddScript(isp_device_id device_id,
         const char* script_string)
 {
-	sendS4("AddScript");
-	receiveS4();
-	//printf("%s\n",recvBuff);
-//	printf("send in host %s\n",script_string);
-	sendS4(script_string);
-	receiveS4();
-	//printf("%s\n",recvBuff);
-	return 1;
+	IspDevice* device = getDevice(device_id);
+	struct iovec field = ispFieldString(script_string);
+	return device && requestS4(device, ISP_MSG_ADD_SCRIPT, &field, 1, NULL)==0;
 }
 
 // remove whole scripts in the storage
 isp_int ispClearScript(isp_device_id device_id)
 {
-	sendS4("ClearScript");
-	receiveS4();
-	return 1;
+	IspDevice* device = getDevice(device_id);
+	return device && requestS4(device, ISP_MSG_CLEAR_SCRIPT, NULL, 0, NULL)==0;
 }
 
 // ispSetActorArgument provides data values to actors.
@@ -119,112 +276,284 @@ isp_int ispSetActorArgument(isp_device_id device_id,
 	return 1;
 }
 
+// callback registry. names are interned to ids at registration and the device
+// is told the id, so it can address a callback without sending its name.
+// the id is the slot in mCallbackFunctions plus one, names are found through mCallbackHash.
 #define MAX_REG_FUNCS 1024
+#define CALLBACK_HASH_SIZE 2048		// power of two, twice MAX_REG_FUNCS
 typedef struct {
 	char name[1024];
         void(*func)(isp_device_id,void* data, int* data_size);
 } CallbackFunctionType;
 static CallbackFunctionType mCallbackFunctions[MAX_REG_FUNCS];
 static int mNumCallbackFunctions = 0;
+static int mCallbackHash[CALLBACK_HASH_SIZE];	// slot+1, 0 is empty
+static pthread_rwlock_t mCallbackLock = PTHREAD_RWLOCK_INITIALIZER;
+
+static unsigned int hashName(const char* name)
+{
+	unsigned int h = 2166136261u;
+	while(*name) h = (h ^ (unsigned char)*name++) * 16777619u;
+	return h;
+}
+
+// slot of a registered name or -1, with mCallbackLock held
+static int findCallback(const char* name)
+{
+	unsigned int h = hashName(name) & (CALLBACK_HASH_SIZE-1);
+	while(mCallbackHash[h]) {
+		if(strcmp(mCallbackFunctions[mCallbackHash[h]-1].name, name)==0)
+			return mCallbackHash[h]-1;
+		h = (h+1) & (CALLBACK_HASH_SIZE-1);
+	}
+	return -1;
+}
+
+// a receive callback may grow the value in place by this many bytes
+#define CALLBACK_DATA_SIZE 65536
+
+static void sendCallbackReply(IspDevice* device, uint32_t request_id, const struct iovec* fields, int num_fields)
+{
+	pthread_mutex_lock(&device->sendLock);
+	ispSendMsg(device->callbackfd, ISP_MSG_REPLY, request_id, fields, num_fields);
+	pthread_mutex_unlock(&device->sendLock);
+}
+
+static void replyStatus(IspDevice* device, uint32_t request_id, uint32_t status, const void* data, size_t size)
+{
+	uint32_t statusField;
+	struct iovec fields[2];
+
+	fields[0] = ispFieldU32(&statusField, status);
+	fields[1] = ispFieldData(data, size);
+	sendCallbackReply(device, request_id, fields, data ? 2 : 1);
+}
+
+// one message from the device, run by a handler thread
+static void handleCallbackMessage(IspDevice* device, isp_msg* msg)
+{
+	char nodeName[BUFF_SIZE], funcName[BUFF_SIZE], name[2*BUFF_SIZE+2];
+	int type = msg->type;
+	int i;
+
+	if(type==ISP_MSG_CALLBACK_SEND || type==ISP_MSG_CALLBACK_RECEIVE) {
+		// fields are either id, value or node, function, value
+		int valueField = msg->num_fields>2 ? 2 : 1;
+		int valueSize = msg->num_fields>valueField ? msg->field_length[valueField] : 0;
+		int capacity = valueSize+CALLBACK_DATA_SIZE;
+		char* value = (char*)malloc(capacity);
+		void(*func)(isp_device_id,void* data, int* data_size) = NULL;
+
+		if(valueSize>0) memcpy(value, msg->field[valueField], valueSize);
+		pthread_rwlock_rdlock(&mCallbackLock);
+		if(valueField==1) {
+			i = (int)ispMsgU32(msg, 0)-1;
+			if(i>=0 && i<mNumCallbackFunctions) func = mCallbackFunctions[i].func;
+		} else {
+			sprintf(name,"%s_%s",ispMsgString(msg, 0, nodeName, BUFF_SIZE),ispMsgString(msg, 1, funcName, BUFF_SIZE));
+			i = findCallback(name);
+			if(i>=0) func = mCallbackFunctions[i].func;
+		}
+		pthread_rwlock_unlock(&mCallbackLock);
+
+		// call callback function
+		if(func) func(deviceID(device),(void*)value,&valueSize);
+		if(valueSize<0) valueSize = 0;
+		if(valueSize>capacity) valueSize = capacity;
+		if(type==ISP_MSG_CALLBACK_RECEIVE)
+			replyStatus(device, msg->request_id, func ? 0 : 1, value, valueSize);
+		else
+			replyStatus(device, msg->request_id, func ? 0 : 1, NULL, 0);
+		free(value);
+	} else if(type==ISP_MSG_S4_FOPEN) {
+		char filename[PATH_MAX], mode[16];
+		uint32_t handle, statusField, handleField;
+		struct iovec fields[2];
+
+		// fopen(filename,mode), handle 0 is never used so it can mean failure
+		handle = 0;
+		pthread_mutex_lock(&device->hostFileLock);
+		for(i=1; i<MAX_HOST_FILES && device->hostFiles[i]; i++);
+		if(i<MAX_HOST_FILES) {
+			device->hostFiles[i] = fopen(ispMsgString(msg, 0, filename, sizeof(filename)),ispMsgString(msg, 1, mode, sizeof(mode)));
+			if(device->hostFiles[i]) handle = i;
+		}
+		pthread_mutex_unlock(&device->hostFileLock);
+		fields[0] = ispFieldU32(&statusField, handle ? 0 : 1);
+		fields[1] = ispFieldU32(&handleField, handle);
+		sendCallbackReply(device, msg->request_id, fields, 2);
+	} else if(type==ISP_MSG_S4_FREAD) {
+		// fread(/*void * ptr*/, size_t size, size_t nitems, FILE * stream)
+		uint64_t size = ispMsgU64(msg, 0);
+		uint64_t nitems = ispMsgU64(msg, 1);
+		uint32_t handle = ispMsgU32(msg, 2);
+		FILE* stream;
+		char* ptr = NULL;
+		size_t n = 0;
+
+		pthread_mutex_lock(&device->hostFileLock);
+		stream = handle<MAX_HOST_FILES ? device->hostFiles[handle] : NULL;
+		// FIXME : we need to compute a LBA in a real board.
+		if(stream && size>0 && nitems<=ISP_MSG_MAX_LENGTH/size) {
+			ptr = (char*)malloc(size*nitems);
+			if(ptr) n = fread(ptr,size,nitems,stream);
+		}
+		pthread_mutex_unlock(&device->hostFileLock);
+		replyStatus(device, msg->request_id, stream ? 0 : 1, ptr ? ptr : "", n*size);
+		free(ptr);
+	} else if(type==ISP_MSG_S4_FCLOSE) {
+		uint32_t handle = ispMsgU32(msg, 0);
+		int status = 1;
+
+		pthread_mutex_lock(&device->hostFileLock);
+		if(handle<MAX_HOST_FILES && device->hostFiles[handle]) {
+			status = fclose(device->hostFiles[handle])==0 ? 0 : 1;
+			device->hostFiles[handle] = NULL;
+		}
+		pthread_mutex_unlock(&device->hostFileLock);
+		replyStatus(device, msg->request_id, status, NULL, 0);
+	}
+}
+
+// callback dispatch: one epoll thread reads whole messages off the callback sockets
+// of all devices and queues them for a pool of handler threads, so a slow callback does
+// not hold up the others. with more than one handler callbacks may run out of order.
+// s4_fopen/fread/fclose are not callbacks: a fread reads at the file position and an
+// fclose must not overtake a fread, so the file messages of a device are handed to the
+// pool one at a time in the order they arrived.
+// the thread and the pool start with the first device and live as long as the process.
+#define MAX_CALLBACK_THREADS 64
+#define MAX_CALLBACK_EVENTS 16
+typedef struct CallbackWork {
+	IspDevice* device;
+	isp_msg msg;
+	struct CallbackWork* next;
+} CallbackWork;
+static CallbackWork* mWorkHead = NULL;
+static CallbackWork* mWorkTail = NULL;
+static pthread_mutex_t mWorkLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mWorkCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t mDrainCond = PTHREAD_COND_INITIALIZER;	// pendingWork or callbackClosed of a device changed
+static int mNumCallbackThreads = 4;
+static pthread_t mCallbackThreads[MAX_CALLBACK_THREADS];
+static pthread_t mDispatchThread;
+
+static int isFileMessage(int type)
+{
+	return type==ISP_MSG_S4_FOPEN || type==ISP_MSG_S4_FREAD || type==ISP_MSG_S4_FCLOSE;
+}
+
+// with mWorkLock
+static void queueWork(CallbackWork* work)
+{
+	work->next = NULL;
+	if(mWorkTail) mWorkTail->next = work;
+	else mWorkHead = work;
+	mWorkTail = work;
+	pthread_cond_signal(&mWorkCond);
+}
+
+void ispSetCallbackThreads(int num_threads)
+{
+	if(num_threads<1) num_threads = 1;
+	if(num_threads>MAX_CALLBACK_THREADS) num_threads = MAX_CALLBACK_THREADS;
+	mNumCallbackThreads = num_threads;
+}
+
+static void* callbackWorker(void* data)
+{
+	CallbackWork* work;
+	CallbackWork* next;
+	IspDevice* device;
+
+	while(1) {
+		pthread_mutex_lock(&mWorkLock);
+		while(mWorkHead==NULL)
+			pthread_cond_wait(&mWorkCond, &mWorkLock);
+		work = mWorkHead;
+		mWorkHead = work->next;
+		if(mWorkHead==NULL) mWorkTail = NULL;
+		pthread_mutex_unlock(&mWorkLock);
+
+		handleCallbackMessage(work->device, &work->msg);
+
+		pthread_mutex_lock(&mWorkLock);
+		device = work->device;
+		if(isFileMessage(work->msg.type)) {
+			// hand the next file message of the device to the pool
+			next = device->fileHead;
+			if(next) {
+				device->fileHead = next->next;
+				if(device->fileHead==NULL) device->fileTail = NULL;
+				queueWork(next);
+			} else
+				device->fileBusy = 0;
+		}
+		if(--device->pendingWork==0)
+			pthread_cond_broadcast(&mDrainCond);
+		pthread_mutex_unlock(&mWorkLock);
+		ispMsgFree(&work->msg);
+		free(work);
+	}
+	return NULL;
+}
 
 // callback function handler thread
 void* callbackFunctionHandler(void* data)
 {
-	char buffer[BUFF_SIZE];
-	char nodeName[BUFF_SIZE],funcName[BUFF_SIZE], size[BUFF_SIZE], value[BUFF_SIZE];
-	int n;
-	memset(buffer,0,BUFF_SIZE);
-	while((n=read(callbackfd, buffer, BUFF_SIZE))>0) {
-		if(strcmp("send callbackFunction",buffer)==0) {
-			sprintf(buffer,"OK");
-			write(callbackfd, buffer, 3);
-		
-			// receive node,funcName
-			read(callbackfd,nodeName,BUFF_SIZE);
-			write(callbackfd, buffer, 3);
-			read(callbackfd,funcName,BUFF_SIZE);
-			write(callbackfd, buffer, 3);
-			read(callbackfd,size,BUFF_SIZE);
-			write(callbackfd, buffer, 3);
-			read(callbackfd,value,BUFF_SIZE);
-			write(callbackfd, buffer, 3);
-
-			sprintf(buffer,"%s_%s",nodeName,funcName);
-
-			// call callback function
-			int i;
-			for(i=0; i<mNumCallbackFunctions; i++) {
-				if(strcmp(mCallbackFunctions[i].name,buffer)==0) {
-					int valueSize = atoi(size);
-					mCallbackFunctions[i].func(1,(void*)value,&valueSize);
-					break;
-				}
+	struct epoll_event events[MAX_CALLBACK_EVENTS];
+	CallbackWork* work;
+	IspDevice* device;
+	int i, n;
+
+	while(1) {
+		n = epoll_wait(mEpollFd, events, MAX_CALLBACK_EVENTS, -1);
+		if(n<0 && errno==EINTR) continue;
+		if(n<0) break;
+
+		for(i=0; i<n; i++) {
+			device = (IspDevice*)events[i].data.ptr;
+			work = (CallbackWork*)calloc(1, sizeof(CallbackWork));
+			work->device = device;
+			if(ispRecvMsg(device->callbackfd, &work->msg)<=0) {
+				// the device closed the socket, ispExit waits for its queued work
+				epoll_ctl(mEpollFd, EPOLL_CTL_DEL, device->callbackfd, NULL);
+				ispMsgFree(&work->msg);
+				free(work);
+				pthread_mutex_lock(&mWorkLock);
+				device->callbackClosed = 1;
+				pthread_cond_broadcast(&mDrainCond);
+				pthread_mutex_unlock(&mWorkLock);
+				continue;
 			}
-		} else if(strcmp("receive callbackFunction",buffer)==0) {
-			sprintf(buffer,"OK");
-			write(callbackfd, buffer, 3);
-		
-			// receive node,funcName
-			read(callbackfd,nodeName,BUFF_SIZE);
-			write(callbackfd, buffer, 3);
-			read(callbackfd,funcName,BUFF_SIZE);
-			write(callbackfd, buffer, 3);
-			read(callbackfd,size,BUFF_SIZE);
-
-			sprintf(buffer,"%s_%s",nodeName,funcName);
-
-			// call callback function
-			int i;
-			for(i=0; i<mNumCallbackFunctions; i++) {
-				if(strcmp(mCallbackFunctions[i].name,buffer)==0) {
-					int valueSize = atoi(size);
-					mCallbackFunctions[i].func(1,(void*)value,&valueSize);
-
-					sprintf(buffer,"%d",valueSize);
-					write(callbackfd, buffer, sizeof(int));
-
-					read(callbackfd,size,BUFF_SIZE);
-					write(callbackfd, value, valueSize);
-					
-					break;
-				}
+			pthread_mutex_lock(&mWorkLock);
+			device->pendingWork++;
+			if(isFileMessage(work->msg.type) && device->fileBusy) {
+				// wait behind the file message queued or running
+				if(device->fileTail) device->fileTail->next = work;
+				else device->fileHead = work;
+				device->fileTail = work;
+			} else {
+				if(isFileMessage(work->msg.type)) device->fileBusy = 1;
+				queueWork(work);
 			}
-		} else if(strcmp("s4_fopen",buffer)==0) {
-			char filename[BUFF_SIZE],mode[BUFF_SIZE];
-
-			sprintf(buffer,"OK");
-			write(callbackfd, buffer, 3);
-		
-			// fopen(filename,mode)
-			read(callbackfd,filename,BUFF_SIZE);
-			write(callbackfd, buffer, 3);
-
-			read(callbackfd,mode,BUFF_SIZE);
-
-			FILE* file = fopen(filename,mode);
-			write(callbackfd, (char*)file, sizeof(FILE*));
-		} else if(strcmp("s4_fread",buffer)==0) {
-			size_t size, nitems;
-			FILE* stream;
-
-			sprintf(buffer,"OK");
-			write(callbackfd, buffer, 3);
-		
-			// fread(/*void * ptr*/, size_t size, size_t nitems, FILE * stream)
-			read(callbackfd,(char*)&size,sizeof(size_t));
-			write(callbackfd, buffer, 3);
-
-			read(callbackfd,(char*)&nitems,sizeof(size_t));
-			write(callbackfd, buffer, 3);
-
-			read(callbackfd,(FILE*)&stream,sizeof(FILE*));
-
-			// FIXME : we need to compute a LBA in a real board.
-			char ptr[BUFF_SIZE];
-			fread(ptr,size,nitems,stream);
-			write(callbackfd, &ptr, sizeof(int));
+			pthread_mutex_unlock(&mWorkLock);
 		}
 	}
+	return NULL;
+}
+
+static void startCallbackDispatch()
+{
+	int i;
+
+	mEpollFd = epoll_create1(0);
+	for(i=0; i<mNumCallbackThreads; i++) {
+		pthread_create(&mCallbackThreads[i], NULL, callbackWorker, NULL);
+		pthread_detach(mCallbackThreads[i]);
+	}
+	pthread_create(&mDispatchThread, NULL, callbackFunctionHandler, NULL);
+	pthread_detach(mDispatchThread);
 }
 			
 // callback function is called by actor instance
@@ -233,12 +562,44 @@ void ispRegisterCallbackFunction(isp_device_id device_id,
         const char* func_name,                                          // callback function name in the actor
         void(*func)(isp_device_id,void* data, int* data_size))       // callback function pointer in host
 {
-	sprintf(mCallbackFunctions[mNumCallbackFunctions].name,"%s_%s",instance_name,func_name); 
-	mCallbackFunctions[mNumCallbackFunctions].func = func;
+	// a function may be registered before any device is open
+	IspDevice* device = device_id>0 ? getDevice(device_id) : NULL;
+	char name[sizeof(mCallbackFunctions[0].name)];
+	uint32_t idField;
+	struct iovec fields[3];
+	int i;
 
-	mNumCallbackFunctions++;
+	if(snprintf(name, sizeof(name), "%s_%s", instance_name, func_name)>=(int)sizeof(name)) {
+		printf("\n Error : callback name %s_%s is too long \n", instance_name, func_name);
+		return;
+	}
+
+	pthread_rwlock_wrlock(&mCallbackLock);
+	i = findCallback(name);
+	if(i<0) {
+		if(mNumCallbackFunctions>=MAX_REG_FUNCS) {
+			pthread_rwlock_unlock(&mCallbackLock);
+			printf("\n Error : too many callback functions \n");
+			return;
+		}
+		i = mNumCallbackFunctions++;
+		strcpy(mCallbackFunctions[i].name, name);
+		unsigned int h = hashName(name) & (CALLBACK_HASH_SIZE-1);
+		while(mCallbackHash[h]) h = (h+1) & (CALLBACK_HASH_SIZE-1);
+		mCallbackHash[h] = i+1;
+	}
+	// registering a name again replaces the function and keeps the id
+	mCallbackFunctions[i].func = func;
+	pthread_rwlock_unlock(&mCallbackLock);
 
-//	return mNumCallbackFunctions;
+	// tell the device the id of the name. the registry is shared by all devices,
+	// a function registered on one is found by name from the others.
+	if(device) {
+		fields[0] = ispFieldString(instance_name);
+		fields[1] = ispFieldString(func_name);
+		fields[2] = ispFieldU32(&idField, i+1);
+		requestS4(device, ISP_MSG_REGISTER_CALLBACK, fields, 3, NULL);
+	}
 }
 
 // It supports two modes of execution: release and debug.
@@ -248,18 +609,35 @@ isp_int ispRunScript(isp_device_id device_id,
         int isp_debug_mode,
         void(*printFunction)(char* message))
 {
-	sendS4("RunScript");
-	while(1) {
-		receiveS4();
-		if(strcmp("OK",recvBuff)==0) break;
-	}
-	printf("%s\n",recvBuff);
-	return 1;
+	IspDevice* device = getDevice(device_id);
+	int status = device ? requestS4(device, ISP_MSG_RUN_SCRIPT, NULL, 0, isp_debug_mode ? printFunction : NULL) : -1;
+	printf("%s\n",status==0 ? "OK" : "failed");
+	return status==0;
 }
 
 isp_int ispExit(isp_device_id device_id)
 {
-	sendS4("exit");
+	IspDevice* device = getDevice(device_id);
+	int i;
+
+	if(device==NULL) return 0;
+
+	// there is no reply. stop reading callbacks and wait for the handlers still
+	// running for this device before its sockets and slot are released.
+	pthread_mutex_lock(&device->lock);
+	ispSendMsg(device->sockfd, ISP_MSG_EXIT, ++device->requestId, NULL, 0);
+	pthread_mutex_unlock(&device->lock);
+	shutdown(device->callbackfd, SHUT_RD);
+	pthread_mutex_lock(&mWorkLock);
+	while(!device->callbackClosed || device->pendingWork>0)
+		pthread_cond_wait(&mDrainCond, &mWorkLock);
+	pthread_mutex_unlock(&mWorkLock);
+
+	close(device->callbackfd);
+	close(device->sockfd);
+	for(i=1; i<MAX_HOST_FILES; i++)
+		if(device->hostFiles[i]) fclose(device->hostFiles[i]);
+	freeDevice(device);
 
 	return 1;
 }
@@ -276,80 +654,381 @@ isp_int ispGetLBAList(isp_device_id device_id,
 }
 
 
+// the isp program reads its thread count from S4_NUMPROCS, see s4_numprocs().
+// se.py replaces the program environment with the lines of this file.
+#define GEM5_ENVFILE "gem5_env.txt"
+static void writeEnvFile(const char* dir, int numprocs)
+{
+	char path[PATH_MAX+32];
+	FILE* fp;
+
+	if(dir) snprintf(path, sizeof(path), "%s/%s", dir, GEM5_ENVFILE);
+	else snprintf(path, sizeof(path), "%s", GEM5_ENVFILE);
+	fp = fopen(path, "w");
+	if(fp==NULL) return;
+	fprintf(fp, "S4_NUMPROCS=%d\n", numprocs);
+	fclose(fp);
+}
+
+// native mode runs <program>.host from make host instead of gem5.
+// s4lib models the flash time as under gem5, the exit tick is the wall-clock time.
+static int mRunMode = -1;
+
+void ispSetRunMode(int mode)
+{
+	mRunMode = mode;
+}
+
+int ispGetRunMode()
+{
+	if(mRunMode<0) {
+		const char* value = getenv("ISP_RUN_MODE");
+		mRunMode = value && strcmp(value, "native")==0 ? ISP_RUN_NATIVE : ISP_RUN_GEM5;
+	}
+	return mRunMode;
+}
+
+// wall-clock in ticks (ps)
+static long long wallTicks()
+{
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return ((long long)t.tv_sec*1000000+t.tv_usec)*1000000;
+}
+
+// <program>.host, the arm binary does not run on the host
+static int nativeProgram(char* program, size_t size, const char* program_file_name)
+{
+	snprintf(program, size, "%s.host", program_file_name);
+	if(access(program, X_OK)!=0) {
+		printf("\n Error : %s is not built, run make host \n", program);
+		return 0;
+	}
+	return 1;
+}
+
+static void nativeCommand(char* command, size_t size, const char* program, const char* program_argument, const char* program_output_file, int numprocs)
+{
+	snprintf(command, size, "S4_NUMPROCS=%d %s %s > %s", numprocs, program, program_argument ? program_argument : "", program_output_file);
+}
+
+// run the command and write its wall-clock time to gem5_result.txt the way gem5 reports the exit tick.
+// a run that crashed or exited non zero leaves no gem5_result.txt, so it reads as 0 cycles.
+// m5out/stats.txt of an earlier gem5 run in the same directory would be collected as this run's.
+// returns the exit status of the program, 127 when it did not exit
+static int runNative(const char* command)
+{
+	long long start;
+	int status;
+	FILE* fp;
+
+	remove("gem5_result.txt");
+	remove("m5out/stats.txt");
+	start = wallTicks();
+	status = system(command);
+	status = status!=-1 && WIFEXITED(status) ? WEXITSTATUS(status) : 127;
+	if(status!=0) {
+		printf("\n Error : %s failed with status %d \n", command, status);
+		return status;
+	}
+	fp = fopen("gem5_result.txt", "w");
+	if(fp) {
+		fprintf(fp, "Exiting @ tick %lld because native run exited\n", wallTicks()-start);
+		fclose(fp);
+	}
+	return 0;
+}
+
 // run the downloaded binary program in ISSD
 // simulation implementation
 isp_int ispRunBinaryFile(isp_device_id device_id, const char* program_file_name, const char* program_argument, const char* program_output_file)
 {
 	char command[1024];
-	if(program_argument)
-		sprintf(command,"%s %s -n %d -c %s -o \"%s \" --output=%s > gem5_result.txt",GEM5_EXECFILE, GEM5_PLATFORM, GEM5_NUMPROCS,program_file_name, program_argument, program_output_file);
-	else
-		sprintf(command,"%s %s -n %d -c %s --output=%s > gem5_result.txt", GEM5_EXECFILE, GEM5_PLATFORM, GEM5_NUMPROCS, program_file_name, program_output_file);
+	// only kernels that call s4_wrapup_simulation write io_stat.txt, a stale one
+	// would add the previous stage's io to this run
+	remove("io_stat.txt");
+	if(ispGetRunMode()==ISP_RUN_NATIVE) {
+		char program[PATH_MAX+8];
+		if(!nativeProgram(program, sizeof(program), program_file_name))
+			return -1;
+		nativeCommand(command, sizeof(command), program, program_argument, program_output_file, GEM5_NUMPROCS);
+		printf("%s\n",command);
+		if(runNative(command)!=0)
+			return -1;
+	} else {
+		writeEnvFile(NULL, GEM5_NUMPROCS);
+		if(program_argument)
+			sprintf(command,"%s %s --env=" GEM5_ENVFILE " -n %d -c %s -o \"%s \" --output=%s > gem5_result.txt",GEM5_EXECFILE, GEM5_PLATFORM, GEM5_NUMPROCS,program_file_name, program_argument, program_output_file);
+		else
+			sprintf(command,"%s %s --env=" GEM5_ENVFILE " -n %d -c %s --output=%s > gem5_result.txt", GEM5_EXECFILE, GEM5_PLATFORM, GEM5_NUMPROCS, program_file_name, program_output_file);
 
-	printf("%s\n",command);
-	system(command);
+		printf("%s\n",command);
+		system(command);
+	}
 
-	// read gem5_result.txt to obtain the isp program cycles and return it.
-	// TODO ...
-	int cycle;
-	cycle = getTickCycle("gem5_result.txt");
-	cycle += getTickCycle("io_stat.txt");
+	// read gem5_result.txt and io_stat.txt to obtain the isp program cycles and return it.
+	// the 64-bit total is kept in the stats table by ispStatsCollect.
+	long long cycle;
+	cycle = ispStatsReadTick("gem5_result.txt");
+	cycle += ispStatsReadTick("io_stat.txt");
 
-	return cycle;
+	return cycle>INT_MAX ? INT_MAX : (isp_int)cycle;
 
 }
 
 isp_int ispRunBinaryFileEx(isp_device_id device_id, const char* program_file_name, const char* program_argument, const char* program_output_file, const int numprocs, const char* clocks)
 {
 	char command[1024];
-	if(program_argument)
-		sprintf(command,"%s %s -n %d --sys-clock \'%s\' --cpu-clock \'%s\' -c %s -o \"%s \" --output=%s > gem5_result.txt",GEM5_EXECFILE, GEM5_PLATFORM, numprocs, clocks, clocks, program_file_name, program_argument, program_output_file);
-	else
-		sprintf(command,"%s %s -n %d --sys-clock \'%s\' --cpu-clock \'%s\' -c %s --output=%s > gem5_result.txt", GEM5_EXECFILE, GEM5_PLATFORM, numprocs, clocks, clocks, program_file_name, program_output_file);
+	// only kernels that call s4_wrapup_simulation write io_stat.txt, a stale one
+	// would add the previous stage's io to this run
+	remove("io_stat.txt");
+	if(ispGetRunMode()==ISP_RUN_NATIVE) {
+		char program[PATH_MAX+8];
+		if(!nativeProgram(program, sizeof(program), program_file_name))
+			return -1;
+		nativeCommand(command, sizeof(command), program, program_argument, program_output_file, numprocs);
+		printf("%s\n",command);
+		if(runNative(command)!=0)
+			return -1;
+	} else {
+		writeEnvFile(NULL, numprocs);
+		if(program_argument)
+			sprintf(command,"%s %s --env=" GEM5_ENVFILE " -n %d --sys-clock \'%s\' --cpu-clock \'%s\' -c %s -o \"%s \" --output=%s > gem5_result.txt",GEM5_EXECFILE, GEM5_PLATFORM, numprocs, clocks, clocks, program_file_name, program_argument, program_output_file);
+		else
+			sprintf(command,"%s %s --env=" GEM5_ENVFILE " -n %d --sys-clock \'%s\' --cpu-clock \'%s\' -c %s --output=%s > gem5_result.txt", GEM5_EXECFILE, GEM5_PLATFORM, numprocs, clocks, clocks, program_file_name, program_output_file);
+
+		printf("%s\n",command);
+		system(command);
+	}
 
-	printf("%s\n",command);
-	system(command);
+	// read gem5_result.txt and io_stat.txt to obtain the isp program cycles and return it.
+	// the 64-bit total is kept in the stats table by ispStatsCollect.
+	long long cycle;
+	cycle = ispStatsReadTick("gem5_result.txt");
+	cycle += ispStatsReadTick("io_stat.txt");
 
-	// read gem5_result.txt to obtain the isp program cycles and return it.
-	// TODO ...
-	int cycle;
-	cycle = getTickCycle("gem5_result.txt");
-	cycle += getTickCycle("io_stat.txt");
+	return cycle>INT_MAX ? INT_MAX : (isp_int)cycle;
+}
+
+// asynchronous gem5 jobs
+// every job is a forked shell running gem5 inside its own working directory,
+// so gem5_result.txt, io_stat.txt, the program's files and m5out/ do not collide.
+// the table grows as jobs are submitted, a job id stays valid for the life of the process.
+// the command is freed once the job has started, so a finished job is a few bytes and its workdir.
+enum { ISP_JOB_PENDING, ISP_JOB_RUNNING, ISP_JOB_DONE };
+typedef struct {
+	int state;
+	int native;
+	pid_t pid;
+	int status;
+	long long cycle;
+	char* workdir;
+	char* command;
+} IspJobType;
+static IspJobType* mJobs = NULL;
+static int mNumJobs = 0;
+static int mJobsSize = 0;
+static int mFirstPendingJob = 0;
+static int mNumRunningJobs = 0;
+static int mMaxJobs = 0;
 
-	return cycle;
+void ispSetMaxJobs(int max_jobs)
+{
+	mMaxJobs = max_jobs;
 }
 
+static int maxJobs()
+{
+	if(mMaxJobs<=0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		mMaxJobs = n>0 ? (int)n : 1;
+	}
+	return mMaxJobs;
+}
 
-int getTickCycle(const char* theFileName)
+// the job runs in another directory, so the gem5 paths have to be absolute
+static const char* absolutePath(char* buffer, const char* path)
 {
-	char command[1024];
+	if(realpath(path, buffer)==NULL) {
+		strncpy(buffer, path, PATH_MAX-1);
+		buffer[PATH_MAX-1] = 0;
+	}
+	return buffer;
+}
 
-	sprintf(command, "grep Exiting %s | sed 's/^[A-z @]*//' > gem5_cycle.txt", theFileName);
-	system(command);
-	FILE* ifp;
-	char buffer[1024];
-	ifp = fopen("gem5_cycle.txt","r");
-	int c, index=0;
-	while((c=fgetc(ifp))!=EOF) {
-		if(!isdigit(c)) {
-			break;
+static void startJob(IspJobType* job)
+{
+	printf("[%s] %s\n", job->workdir, job->command);
+	fflush(stdout);
+
+	pid_t pid = fork();
+	if(pid==0) {
+		if(chdir(job->workdir)!=0) _exit(127);
+		// a stale io_stat.txt would be added to the cycles of this run
+		remove("io_stat.txt");
+		if(job->native)
+			_exit(runNative(job->command));
+		execl("/bin/sh", "sh", "-c", job->command, (char*)NULL);
+		_exit(127);
+	}
+	free(job->command);
+	job->command = NULL;
+	if(pid<0) {
+		printf("\n Error : could not start job in %s \n", job->workdir);
+		job->state = ISP_JOB_DONE;
+		job->status = -1;
+		return;
+	}
+	job->pid = pid;
+	job->state = ISP_JOB_RUNNING;
+	mNumRunningJobs++;
+}
+
+// jobs start in submit order, the ones before mFirstPendingJob have all started
+static void startPendingJobs()
+{
+	for(; mFirstPendingJob<mNumJobs && mNumRunningJobs<maxJobs(); mFirstPendingJob++)
+		if(mJobs[mFirstPendingJob].state==ISP_JOB_PENDING)
+			startJob(&mJobs[mFirstPendingJob]);
+}
+
+static void finishJob(IspJobType* job, int status)
+{
+	char path[PATH_MAX+32];
+
+	job->status = status;
+	job->state = ISP_JOB_DONE;
+	mNumRunningJobs--;
+
+	// the same cycles ispRunBinaryFileEx returns, read from the job's directory
+	snprintf(path, sizeof(path), "%s/gem5_result.txt", job->workdir);
+	job->cycle = ispStatsReadTick(path);
+	snprintf(path, sizeof(path), "%s/io_stat.txt", job->workdir);
+	job->cycle += ispStatsReadTick(path);
+}
+
+// collect finished jobs, waits for at least one when block is set
+static void reapJobs(int block)
+{
+	int status, i;
+	pid_t pid;
+
+	while(mNumRunningJobs>0) {
+		pid = waitpid(-1, &status, block ? 0 : WNOHANG);
+		if(pid<0 && errno==EINTR) continue;
+		if(pid<=0) break;
+		for(i=0; i<mNumJobs; i++) {
+			if(mJobs[i].state==ISP_JOB_RUNNING && mJobs[i].pid==pid) {
+				finishJob(&mJobs[i], status);
+				block = 0;
+				break;
+			}
 		}
+	}
+}
+
+isp_job ispSubmitBinaryFileEx(isp_device_id device_id, const char* workdir, const char* program_file_name, const char* program_argument, const char* program_output_file, const int numprocs, const char* clocks)
+{
+	char gem5[PATH_MAX], platform[PATH_MAX], program[PATH_MAX], host[PATH_MAX+8];
+	char workpath[PATH_MAX], command[3*PATH_MAX+1024];
+	IspJobType* job;
+
+	if(ispGetRunMode()==ISP_RUN_NATIVE && !nativeProgram(host, sizeof(host), program_file_name))
+		return -1;
+	if(mkdir(workdir, 0755)!=0 && errno!=EEXIST) {
+		printf("\n Error : could not create %s \n", workdir);
+		return -1;
+	}
+
+	if(mNumJobs==mJobsSize) {
+		int size = mJobsSize ? mJobsSize*2 : 1024;
+		IspJobType* jobs = (IspJobType*)realloc(mJobs, sizeof(IspJobType)*size);
+		if(jobs==NULL) {
+			printf("\n Error : too many jobs \n");
+			return -1;
+		}
+		mJobs = jobs;
+		mJobsSize = size;
+	}
+
+	absolutePath(workpath, workdir);
+	absolutePath(gem5, GEM5_EXECFILE);
+	absolutePath(platform, GEM5_PLATFORM);
+	absolutePath(program, program_file_name);
+
+	if(ispGetRunMode()==ISP_RUN_NATIVE) {
+		absolutePath(program, host);
+		nativeCommand(command, sizeof(command), program, program_argument, program_output_file, numprocs);
+	} else if(program_argument)
+		snprintf(command, sizeof(command), "%s --outdir=m5out %s --env=" GEM5_ENVFILE " -n %d --sys-clock \'%s\' --cpu-clock \'%s\' -c %s -o \"%s \" --output=%s > gem5_result.txt", gem5, platform, numprocs, clocks, clocks, program, program_argument, program_output_file);
+	else
+		snprintf(command, sizeof(command), "%s --outdir=m5out %s --env=" GEM5_ENVFILE " -n %d --sys-clock \'%s\' --cpu-clock \'%s\' -c %s --output=%s > gem5_result.txt", gem5, platform, numprocs, clocks, clocks, program, program_output_file);
 
-		buffer[index] = c;
-		++index;
+	job = &mJobs[mNumJobs];
+	memset(job, 0, sizeof(IspJobType));
+	job->cycle = -1;
+	job->native = ispGetRunMode()==ISP_RUN_NATIVE;
+	job->workdir = strdup(workpath);
+	job->command = strdup(command);
+	if(job->workdir==NULL || job->command==NULL) {
+		free(job->workdir);
+		free(job->command);
+		printf("\n Error : too many jobs \n");
+		return -1;
 	}
+	writeEnvFile(job->workdir, numprocs);
+	job->state = ISP_JOB_PENDING;
+	mNumJobs++;
+
+	reapJobs(0);
+	startPendingJobs();
+
+	return mNumJobs-1;
+}
 
-	buffer[index] = 0;
-	
-	int cycle = 0;
-	if(index>0) cycle = atoi(buffer);
-	system("rm gem5_cycle.txt");
-		
+isp_int ispPollJob(isp_job job)
+{
+	if(job<0 || job>=mNumJobs) return -1;
+
+	reapJobs(0);
+	startPendingJobs();
+
+	return mJobs[job].state==ISP_JOB_DONE;
+}
+
+isp_int ispWaitAllJobs()
+{
+	int i, failed = 0;
+
+	startPendingJobs();
+	while(mNumRunningJobs>0) {
+		reapJobs(1);
+		startPendingJobs();
+	}
 
-	sprintf(command,"rm %s", theFileName);
-//	system(command);
+	for(i=0; i<mNumJobs; i++)
+		if(!WIFEXITED(mJobs[i].status) || WEXITSTATUS(mJobs[i].status)!=0)
+			failed++;
+	return failed;
+}
 
-	return cycle; 
+long long ispJobCycle(isp_job job)
+{
+	if(ispJobStatus(job)!=0) return -1;
+	return mJobs[job].cycle;
 }
 
+isp_int ispJobStatus(isp_job job)
+{
+	int status;
+	if(job<0 || job>=mNumJobs || mJobs[job].state!=ISP_JOB_DONE) return -1;
+	status = mJobs[job].status;
+	if(status==-1 || !WIFEXITED(status)) return -1;
+	return WEXITSTATUS(status);
+}
 
+const char* ispJobWorkdir(isp_job job)
+{
+	if(job<0 || job>=mNumJobs) return NULL;
+	return mJobs[job].workdir;
+}
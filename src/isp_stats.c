@@ -0,0 +1,225 @@
+// in-process stats collector for the isp drivers
+// it replaces grep/sed/cp on gem5 output files
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "isp_stats.h"
+
+#define GEM5_STATS_FILE "m5out/stats.txt"
+#define GEM5_RESULT_FILE "gem5_result.txt"
+#define S4_IO_FILE "io_stat.txt"
+
+static isp_stage_stats* stageList = NULL;
+static int stageCount = 0;
+static int stageSize = 0;
+
+long long ispStatsReadTick(const char* fileName)
+{
+	char line[1024];
+	char* p;
+	long long tick = 0;
+	FILE* ifp = fopen(fileName, "r");
+
+	if(ifp==NULL) return 0;
+	while(fgets(line, sizeof(line), ifp)) {
+		p = strstr(line, "Exiting @ tick");
+		if(p) {
+			tick = strtoll(p+strlen("Exiting @ tick"), NULL, 10);
+			break;
+		}
+	}
+	fclose(ifp);
+	return tick;
+}
+
+int ispStatsReadValue(const char* fileName, const char* key, long long* value)
+{
+	char line[1024];
+	char name[512];
+	int found = 0;
+	FILE* ifp = fopen(fileName, "r");
+
+	if(ifp==NULL) return 0;
+	while(fgets(line, sizeof(line), ifp)) {
+		if(sscanf(line, "%511s", name)!=1 || strcmp(name, key)!=0) continue;
+		*value = strtoll(line+strlen(name), NULL, 10);
+		found = 1;
+	}
+	fclose(ifp);
+	return found;
+}
+
+// a miss counter of a cache, old (overall_misses) and new (overallMisses) gem5 names
+static int isMissTotal(const char* name, const char* cache)
+{
+	const char* p = strstr(name, cache);
+	if(p==NULL) return 0;
+	p += strlen(cache);
+	return strcmp(p, "overall_misses::total")==0 || strcmp(p, "overallMisses::total")==0;
+}
+
+// the counters of one "Begin Simulation Statistics" dump
+enum { GEM5_SIM_TICKS, GEM5_SIM_INSTS, GEM5_ICACHE_MISSES, GEM5_DCACHE_MISSES, GEM5_L2_MISSES, GEM5_NUM_STATS };
+
+// one pass over stats.txt, every dump is parsed.
+// a kernel without S4_M5OPS leaves one dump, gem5's exit dump of the whole run.
+// with S4_M5OPS every outermost s4 region resets the stats at its begin and dumps them
+// at its end, and gem5's exit dump comes last. it covers the last region again plus
+// the tail after it, so the region dumps before it are summed and it is left out.
+static void readGem5Stats(const char* fileName, isp_stage_stats* s)
+{
+	char line[1024];
+	char name[512];
+	long long value;
+	long long sum[GEM5_NUM_STATS] = {0};
+	long long dump[GEM5_NUM_STATS] = {0};
+	int dumps = 0, i;
+	FILE* ifp = fopen(fileName, "r");
+
+	if(ifp==NULL) return;
+	while(fgets(line, sizeof(line), ifp)) {
+		if(strstr(line, "Begin Simulation Statistics")) {
+			for(i=0; i<GEM5_NUM_STATS; i++) {
+				sum[i] += dump[i];
+				dump[i] = 0;
+			}
+			dumps++;
+			continue;
+		}
+		if(dumps==0 || sscanf(line, "%511s %lld", name, &value)!=2) continue;
+		if(strcmp(name, "sim_ticks")==0) dump[GEM5_SIM_TICKS] = value;
+		else if(strcmp(name, "sim_insts")==0) dump[GEM5_SIM_INSTS] = value;
+		else if(isMissTotal(name, "icache.")) dump[GEM5_ICACHE_MISSES] += value;
+		else if(isMissTotal(name, "dcache.")) dump[GEM5_DCACHE_MISSES] += value;
+		else if(isMissTotal(name, "l2.")) dump[GEM5_L2_MISSES] += value;
+	}
+	fclose(ifp);
+
+	// sum holds every dump before the last one
+	if(dumps<=1)
+		memcpy(sum, dump, sizeof(sum));
+	s->regions = dumps>1 ? dumps-1 : 0;
+	s->sim_ticks = sum[GEM5_SIM_TICKS];
+	s->sim_insts = sum[GEM5_SIM_INSTS];
+	s->icache_misses = sum[GEM5_ICACHE_MISSES];
+	s->dcache_misses = sum[GEM5_DCACHE_MISSES];
+	s->l2_misses = sum[GEM5_L2_MISSES];
+}
+
+isp_stage_stats* ispStatsCollect(const char* stage)
+{
+	return ispStatsCollectDir(stage, NULL);
+}
+
+static const char* statsPath(char* buffer, const char* dir, const char* fileName)
+{
+	if(dir==NULL || dir[0]==0) return fileName;
+	snprintf(buffer, PATH_MAX, "%s/%s", dir, fileName);
+	return buffer;
+}
+
+isp_stage_stats* ispStatsCollectDir(const char* stage, const char* dir)
+{
+	char path[PATH_MAX];
+	const char* io;
+	isp_stage_stats* s;
+
+	if(stageCount==stageSize) {
+		int size = stageSize ? stageSize*2 : 64;
+		isp_stage_stats* list = (isp_stage_stats*)realloc(stageList, sizeof(isp_stage_stats)*size);
+		if(list==NULL) return NULL;
+		stageList = list;
+		stageSize = size;
+	}
+	s = &stageList[stageCount++];
+	memset(s, 0, sizeof(isp_stage_stats));
+	strncpy(s->stage, stage, sizeof(s->stage)-1);
+	readGem5Stats(statsPath(path, dir, GEM5_STATS_FILE), s);
+	s->exit_tick = ispStatsReadTick(statsPath(path, dir, GEM5_RESULT_FILE));
+	io = statsPath(path, dir, S4_IO_FILE);
+	s->io_ticks = ispStatsReadTick(io);
+	ispStatsReadValue(io, "s4.read_pages", &s->read_pages);
+	ispStatsReadValue(io, "s4.program_pages", &s->program_pages);
+	return s;
+}
+
+int ispStatsCount()
+{
+	return stageCount;
+}
+
+isp_stage_stats* ispStatsGet(int index)
+{
+	if(index<0 || index>=stageCount) return NULL;
+	return &stageList[index];
+}
+
+long long ispStatsTotalTicks()
+{
+	long long total = 0;
+	int i;
+	for(i=0;i<stageCount;i++)
+		total += stageList[i].exit_tick+stageList[i].io_ticks;
+	return total;
+}
+
+int ispStatsWrite(const char* fileName)
+{
+	isp_stage_stats* s;
+	int i;
+	FILE* ofp = fopen(fileName, "w");
+
+	if(ofp==NULL) return -1;
+	fprintf(ofp, "stage,sim_ticks,exit_tick,io_ticks,total_ticks,sim_insts,icache_misses,dcache_misses,l2_misses,read_pages,program_pages,regions\n");
+	for(i=0;i<stageCount;i++) {
+		s = &stageList[i];
+		fprintf(ofp, "%s,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n", s->stage,
+			s->sim_ticks, s->exit_tick, s->io_ticks, s->exit_tick+s->io_ticks, s->sim_insts,
+			s->icache_misses, s->dcache_misses, s->l2_misses, s->read_pages, s->program_pages, s->regions);
+	}
+	fclose(ofp);
+	return 0;
+}
+
+void ispStatsClear()
+{
+	free(stageList);
+	stageList = NULL;
+	stageCount = stageSize = 0;
+}
+
+int ispCopyFile(const char* src, const char* dst)
+{
+	char buffer[65536];
+	size_t n;
+	FILE* ifp = fopen(src, "rb");
+	FILE* ofp;
+
+	if(ifp==NULL) return -1;
+	ofp = fopen(dst, "wb");
+	if(ofp==NULL) {
+		fclose(ifp);
+		return -1;
+	}
+	while((n=fread(buffer, 1, sizeof(buffer), ifp))>0) {
+		if(fwrite(buffer, 1, n, ofp)!=n) {
+			fclose(ifp);
+			fclose(ofp);
+			return -1;
+		}
+	}
+	fclose(ifp);
+	return fclose(ofp)==0 ? 0 : -1;
+}
+
+int ispMoveFile(const char* src, const char* dst)
+{
+	if(rename(src, dst)==0) return 0;
+	// rename cannot cross file systems
+	if(ispCopyFile(src, dst)!=0) return -1;
+	return remove(src);
+}
@@ -2,34 +2,505 @@
 // It is a socket server
 
 
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "s4.h"
+#ifdef S4_M5OPS
+#include "m5op.h"
+#endif
 
 // unit is pico second
-//#define S4_FLASH_READ_LATENCY 200000000
-#define S4_FLASH_READ_LATENCY 0
+#ifndef S4_FLASH_READ_LATENCY
+#define S4_FLASH_READ_LATENCY 50000000		// 50us
+#endif
+#ifndef S4_FLASH_PROGRAM_LATENCY
+#define S4_FLASH_PROGRAM_LATENCY 500000000	// 500us
+#endif
+#ifndef S4_FLASH_ERASE_LATENCY
+#define S4_FLASH_ERASE_LATENCY 3000000000LL	// 3ms
+#endif
+#ifndef S4_FLASH_TRANSFER_LATENCY
+#define S4_FLASH_TRANSFER_LATENCY 2560000	// 1KB page at 400MB/s
+#endif
 
-int s4_tick_time; 
+// flash geometry
+#ifndef S4_FLASH_CHANNELS
+#define S4_FLASH_CHANNELS 8
+#endif
+#ifndef S4_FLASH_DIES
+#define S4_FLASH_DIES 2
+#endif
+#ifndef S4_FLASH_PLANES
+#define S4_FLASH_PLANES 2
+#endif
+#ifndef S4_FLASH_PAGES_PER_BLOCK
+#define S4_FLASH_PAGES_PER_BLOCK 128
+#endif
 
-void s4_spend_time(int theTick)
+#define S4_MAX_FLASH_UNITS 1024
+#define S4_MAX_MAPS 64
+#define S4_MAX_WFILES 16
+#define S4_MAX_THREADS 64
+#define S4_MAX_REGIONS 32
+#define S4_MAX_REGION_DEPTH 8
+
+// dirty pages held before write back
+#ifndef S4_CACHE_PAGES
+#define S4_CACHE_PAGES 256
+#endif
+
+long long s4_tick_time;
+char s4_buffer[S4_PAGE_SIZE*S4_NUM_BUFFERS];
+
+static s4_flash_config s4_flash = {
+	S4_FLASH_READ_LATENCY,
+	S4_FLASH_PROGRAM_LATENCY,
+	S4_FLASH_ERASE_LATENCY,
+	S4_FLASH_TRANSFER_LATENCY,
+	S4_FLASH_CHANNELS,
+	S4_FLASH_DIES,
+	S4_FLASH_PLANES,
+	S4_FLASH_PAGES_PER_BLOCK
+};
+
+// per unit (channel, die, plane) and per channel busy-until ticks
+static long long s4_unit_busy[S4_MAX_FLASH_UNITS];
+static long long s4_unit_programs[S4_MAX_FLASH_UNITS];
+static long long s4_channel_busy[S4_MAX_FLASH_UNITS];
+
+// per-operation counters for io_stat.txt
+static long long s4_read_calls, s4_read_bytes, s4_read_pages, s4_read_ticks;
+static long long s4_write_calls, s4_write_bytes, s4_program_pages, s4_write_ticks;
+static long long s4_erases;
+static long long s4_prefetch_pages, s4_prefetch_ticks, s4_stall_ticks;
+static long long s4_map_calls, s4_map_faults, s4_map_ticks;
+static long long s4_cache_requested, s4_cache_written, s4_cache_unchanged, s4_cache_flushes;
+
+// prefetch ring, one entry per page slot of s4_buffer
+typedef struct s4_slot{
+	int busy;
+	size_t bytes;
+	long long ready;
+} s4_slot;
+static s4_slot s4_ring[S4_NUM_BUFFERS];
+static int s4_ring_next;
+
+// live s4_map views
+typedef struct s4_mapping{
+	const char* view;
+	void* base;
+	size_t length;
+	int mapped;
+} s4_mapping;
+static s4_mapping s4_maps[S4_MAX_MAPS];
+
+// write-back cache: the dirty page set, and per written file the checksum
+// of every page it held when it was opened
+typedef struct s4_dirty{
+	FILE* stream;
+	long page;
+} s4_dirty;
+static s4_dirty s4_cache[S4_CACHE_PAGES];
+static int s4_cache_count;
+
+typedef struct s4_wfile{
+	FILE* stream;
+	char* name;
+	int fd;			// read-only, the stream itself may be write-only
+	unsigned long long* oldsum;
+	long oldpages;
+} s4_wfile;
+static s4_wfile s4_wfiles[S4_MAX_WFILES];
+
+static void s4_cache_flush(FILE* stream);
+
+// regions, index 0 is the whole run of a thread
+typedef struct s4_region_stat{
+	long long calls;
+	long long ticks;
+	long long io_ticks;
+	long long bytes_read;
+	long long bytes_written;
+	long long items;
+} s4_region_stat;
+
+typedef struct s4_thread{
+	pthread_t id;
+	int depth;
+	int stack[S4_MAX_REGION_DEPTH];
+	long long start[S4_MAX_REGION_DEPTH];
+	long long iostart[S4_MAX_REGION_DEPTH];
+	s4_region_stat stat[S4_MAX_REGIONS];
+} s4_thread;
+
+static char s4_region_names[S4_MAX_REGIONS][32] = {"total"};
+static int s4_region_count = 1;
+static s4_thread s4_threads[S4_MAX_THREADS];
+static int s4_thread_count;
+static pthread_mutex_t s4_region_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void s4_account(long long rbytes, long long wbytes, long long items);
+static void s4_write_regions();
+
+// wall time at s4_init_simulation, compute time is measured from here
+static struct timeval s4_start_time;
+
+// kernels may read from several threads
+static pthread_mutex_t s4_flash_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void s4_spend_time(long long theTick)
 {
 	s4_tick_time += theTick;
 }
 
+int s4_numprocs()
+{
+	static int numprocs = 0;
+	const char* value;
+
+	if(numprocs==0) {
+		value = getenv("S4_NUMPROCS");
+		numprocs = value ? atoi(value) : S4_DEFAULT_NUMPROCS;
+		// the kernels split work over numprocs-1 worker threads
+		if(numprocs<2) numprocs = 2;
+		if(numprocs>S4_MAX_NUMPROCS) numprocs = S4_MAX_NUMPROCS;
+	}
+	return numprocs;
+}
+
+static int s4_flash_units()
+{
+	int units = s4_flash.channels*s4_flash.dies*s4_flash.planes;
+	if(units>S4_MAX_FLASH_UNITS) units = S4_MAX_FLASH_UNITS;
+	return units<1 ? 1 : units;
+}
+
+void s4_set_flash_config(const s4_flash_config* config)
+{
+	s4_flash = *config;
+	if(s4_flash.channels<1) s4_flash.channels = 1;
+	if(s4_flash.dies<1) s4_flash.dies = 1;
+	if(s4_flash.planes<1) s4_flash.planes = 1;
+	if(s4_flash.pages_per_block<1) s4_flash.pages_per_block = 1;
+}
+
+void s4_get_flash_config(s4_flash_config* config)
+{
+	*config = s4_flash;
+}
+
+// device clock: compute time so far plus the i/o stalls already charged.
+// under gem5 se mode gettimeofday follows simulated time.
+static long long s4_now()
+{
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return ((long long)(t.tv_sec-s4_start_time.tv_sec)*1000000+(t.tv_usec-s4_start_time.tv_usec))*1000000+s4_tick_time;
+}
+
 void s4_init_simulation()
 {
 	s4_tick_time = 0;
+	gettimeofday(&s4_start_time, NULL);
+	memset(s4_ring, 0, sizeof(s4_ring));
+	s4_ring_next = 0;
+	s4_prefetch_pages = s4_prefetch_ticks = s4_stall_ticks = 0;
+	s4_map_calls = s4_map_faults = s4_map_ticks = 0;
+	s4_cache_requested = s4_cache_written = s4_cache_unchanged = s4_cache_flushes = 0;
+	s4_cache_count = 0;
+	pthread_mutex_lock(&s4_region_lock);
+	memset(s4_threads, 0, sizeof(s4_threads));
+	s4_thread_count = 0;
+	s4_region_count = 1;
+	strcpy(s4_region_names[0], "total");
+	pthread_mutex_unlock(&s4_region_lock);
+	memset(s4_unit_busy, 0, sizeof(s4_unit_busy));
+	memset(s4_unit_programs, 0, sizeof(s4_unit_programs));
+	memset(s4_channel_busy, 0, sizeof(s4_channel_busy));
+	s4_read_calls = s4_read_bytes = s4_read_pages = s4_read_ticks = 0;
+	s4_write_calls = s4_write_bytes = s4_program_pages = s4_write_ticks = 0;
+	s4_erases = 0;
 }
 
 void s4_wrapup_simulation()
 {
-	FILE* stat = fopen("io_stat.txt","w");
-	fprintf(stat, "Exiting @ tick %d\n",s4_tick_time);
+	FILE* stat;
+
+	pthread_mutex_lock(&s4_flash_lock);
+	s4_cache_flush(NULL);
+	pthread_mutex_unlock(&s4_flash_lock);
+
+	stat = fopen("io_stat.txt","w");
+	if(stat==NULL) return;
+	fprintf(stat, "Exiting @ tick %lld\n",s4_tick_time);
+	fprintf(stat, "s4.read_calls %lld\n",s4_read_calls);
+	fprintf(stat, "s4.read_bytes %lld\n",s4_read_bytes);
+	fprintf(stat, "s4.read_pages %lld\n",s4_read_pages);
+	fprintf(stat, "s4.read_ticks %lld\n",s4_read_ticks);
+	fprintf(stat, "s4.write_calls %lld\n",s4_write_calls);
+	fprintf(stat, "s4.write_bytes %lld\n",s4_write_bytes);
+	fprintf(stat, "s4.program_pages %lld\n",s4_program_pages);
+	fprintf(stat, "s4.write_ticks %lld\n",s4_write_ticks);
+	// pages a write-through device would have programmed, one per page touched by each call
+	fprintf(stat, "s4.cache_requested_pages %lld\n",s4_cache_requested);
+	fprintf(stat, "s4.cache_written_pages %lld\n",s4_cache_written);
+	fprintf(stat, "s4.cache_unchanged_pages %lld\n",s4_cache_unchanged);
+	fprintf(stat, "s4.cache_flushes %lld\n",s4_cache_flushes);
+	fprintf(stat, "s4.cache_programs_avoided %lld\n",s4_cache_requested-(s4_cache_written-s4_cache_unchanged));
+	fprintf(stat, "s4.erases %lld\n",s4_erases);
+	fprintf(stat, "s4.prefetch_pages %lld\n",s4_prefetch_pages);
+	fprintf(stat, "s4.prefetch_ticks %lld\n",s4_prefetch_ticks);
+	fprintf(stat, "s4.prefetch_stall_ticks %lld\n",s4_stall_ticks);
+	fprintf(stat, "s4.prefetch_hidden_ticks %lld\n",s4_prefetch_ticks-s4_stall_ticks);
+	fprintf(stat, "s4.map_calls %lld\n",s4_map_calls);
+	fprintf(stat, "s4.map_faults %lld\n",s4_map_faults);
+	fprintf(stat, "s4.map_ticks %lld\n",s4_map_ticks);
+	fprintf(stat, "s4.flash_units %d\n",s4_flash_units());
+	fclose(stat);
+	s4_write_regions();
+}
+
+// issue page p of a file at device time now, return the tick it completes
+// base staggers the stripe so two files do not start on the same unit
+static long long s4_flash_page(int base, long p, int write, long long now)
+{
+	int units = s4_flash_units();
+	int channels = s4_flash.channels<units ? s4_flash.channels : units;
+	long long start, end;
+	int u, c;
+
+	// channel first, so consecutive pages spread over channels before dies and planes
+	u = (int)((p+base)%units);
+	c = u%channels;
+	if(write){
+		start = s4_channel_busy[c]>now ? s4_channel_busy[c] : now;
+		s4_channel_busy[c] = start+s4_flash.transfer_latency;
+		start = s4_unit_busy[u]>s4_channel_busy[c] ? s4_unit_busy[u] : s4_channel_busy[c];
+		// a fresh block has to be erased before its first program
+		if(s4_unit_programs[u]%s4_flash.pages_per_block==0){
+			start += s4_flash.erase_latency;
+			s4_erases++;
+		}
+		s4_unit_programs[u]++;
+		end = start+s4_flash.program_latency;
+		s4_unit_busy[u] = end;
+		s4_program_pages++;
+	}
+	else{
+		start = s4_unit_busy[u]>now ? s4_unit_busy[u] : now;
+		start += s4_flash.read_latency;
+		if(s4_channel_busy[c]>start) start = s4_channel_busy[c];
+		end = start+s4_flash.transfer_latency;
+		// the plane register is held until the page is out
+		s4_unit_busy[u] = end;
+		s4_channel_busy[c] = end;
+		s4_read_pages++;
+	}
+	return end;
+}
+
+// issue pages [first,last] of a file at device time now, return the tick the last one completes
+static long long s4_flash_access(FILE* stream, long first, long last, int write, long long now)
+{
+	long long done = now, end;
+	long p;
+
+	for(p=first;p<=last;p++){
+		end = s4_flash_page(fileno(stream), p, write, now);
+		if(end>done) done = end;
+	}
+	return done;
+}
+
+// charge a read of n bytes starting at offset
+static void s4_read_charge(FILE* stream, long offset, size_t n)
+{
+	long long now, done;
+
+	pthread_mutex_lock(&s4_flash_lock);
+	if(n>0 && offset>=0){
+		now = s4_now();
+		done = s4_flash_access(stream, offset/S4_PAGE_SIZE, (long)((offset+n-1)/S4_PAGE_SIZE), 0, now);
+		s4_read_ticks += done-now;
+		s4_tick_time += done-now;
+	}
+	s4_read_calls++;
+	s4_read_bytes += n;
+	pthread_mutex_unlock(&s4_flash_lock);
+	s4_account(n, 0, 0);
+}
+
+static unsigned long long s4_page_sum(const char* page, size_t n)
+{
+	unsigned long long h = 14695981039346656037ULL^n;
+	size_t i;
+
+	for(i=0;i<n;i++)
+		h = (h^(unsigned char)page[i])*1099511628211ULL;
+	return h;
+}
+
+// checksum every page a file holds before it is opened for writing,
+// so a flush can tell a rewritten page from a changed one
+static unsigned long long* s4_file_sums(const char* filename, long* pages)
+{
+	char page[S4_PAGE_SIZE];
+	unsigned long long* sums = NULL;
+	FILE* old;
+	size_t n;
+	long p;
+
+	*pages = 0;
+	old = fopen(filename, "rb");
+	if(old==NULL) return NULL;
+	fseek(old, 0, SEEK_END);
+	*pages = (ftell(old)+S4_PAGE_SIZE-1)/S4_PAGE_SIZE;
+	rewind(old);
+	if(*pages>0) sums = (unsigned long long*)malloc(sizeof(unsigned long long)*(*pages));
+	if(sums==NULL) *pages = 0;
+	for(p=0;p<*pages;p++){
+		n = fread(page, 1, S4_PAGE_SIZE, old);
+		sums[p] = s4_page_sum(page, n);
+	}
+	fclose(old);
+	return sums;
+}
+
+static s4_wfile* s4_wfile_find(FILE* stream)
+{
+	int i;
+
+	for(i=0;i<S4_MAX_WFILES;i++)
+		if(s4_wfiles[i].stream==stream) return &s4_wfiles[i];
+	return NULL;
+}
+
+// write back the dirty pages of one stream, or of every stream when stream is NULL.
+// pages whose content matches what the flash already holds are dropped,
+// the rest are issued together as full-page programs. called with s4_flash_lock held.
+static void s4_cache_flush(FILE* stream)
+{
+	char page[S4_PAGE_SIZE];
+	long long now, done, end;
+	s4_wfile* wf;
+	unsigned long long sum;
+	ssize_t n;
+	int i, j, flushed = 0;
+
+	if(s4_cache_count==0) return;
+	now = s4_now();
+	done = now;
+	for(i=0;i<s4_cache_count;i++){
+		if(stream!=NULL && s4_cache[i].stream!=stream) continue;
+		fflush(s4_cache[i].stream);
+		wf = s4_wfile_find(s4_cache[i].stream);
+		if(wf!=NULL && wf->fd<0 && wf->name!=NULL) wf->fd = open(wf->name, O_RDONLY);
+		n = (wf!=NULL && wf->fd>=0) ? pread(wf->fd, page, S4_PAGE_SIZE, (off_t)s4_cache[i].page*S4_PAGE_SIZE) : -1;
+		sum = s4_page_sum(page, n>0 ? (size_t)n : 0);
+		if(n>=0 && s4_cache[i].page<wf->oldpages && wf->oldsum[s4_cache[i].page]==sum){
+			s4_cache_unchanged++;
+		}
+		else{
+			end = s4_flash_page(fileno(s4_cache[i].stream), s4_cache[i].page, 1, now);
+			if(end>done) done = end;
+			if(wf!=NULL && s4_cache[i].page<wf->oldpages) wf->oldsum[s4_cache[i].page] = sum;
+		}
+		s4_cache_written++;
+		s4_cache[i].stream = NULL;
+		flushed++;
+	}
+	if(flushed==0) return;
+	s4_write_ticks += done-now;
+	s4_tick_time += done-now;
+	s4_cache_flushes++;
+
+	// compact the dirty set
+	for(i=0,j=0;i<s4_cache_count;i++)
+		if(s4_cache[i].stream!=NULL) s4_cache[j++] = s4_cache[i];
+	s4_cache_count = j;
+}
+
+// mark the pages of a write dirty, they are programmed at the next flush
+static void s4_cache_write(FILE* stream, long offset, size_t n)
+{
+	long p, first, last;
+	int i;
+
+	pthread_mutex_lock(&s4_flash_lock);
+	s4_write_calls++;
+	s4_write_bytes += n;
+	if(n>0 && offset>=0){
+		first = offset/S4_PAGE_SIZE;
+		last = (long)((offset+n-1)/S4_PAGE_SIZE);
+		s4_cache_requested += last-first+1;
+		for(p=first;p<=last;p++){
+			for(i=0;i<s4_cache_count;i++)
+				if(s4_cache[i].stream==stream && s4_cache[i].page==p) break;
+			if(i<s4_cache_count) continue;
+			if(s4_cache_count==S4_CACHE_PAGES) s4_cache_flush(NULL);
+			s4_cache[s4_cache_count].stream = stream;
+			s4_cache[s4_cache_count].page = p;
+			s4_cache_count++;
+		}
+	}
+	pthread_mutex_unlock(&s4_flash_lock);
+	s4_account(0, n, 0);
 }
 
 FILE *
 s4_fopen(const char * filename, const char * mode)
 {
-        return fopen(filename,mode);
+	FILE* stream;
+	unsigned long long* sums = NULL;
+	long pages = 0;
+	int i, write = strchr(mode,'w')!=NULL || strchr(mode,'a')!=NULL || strchr(mode,'+')!=NULL;
+
+	// the old content is hashed before "w" truncates it
+	if(write) sums = s4_file_sums(filename, &pages);
+	stream = fopen(filename,mode);
+	if(stream==NULL || !write){
+		free(sums);
+		return stream;
+	}
+	pthread_mutex_lock(&s4_flash_lock);
+	for(i=0;i<S4_MAX_WFILES;i++)
+		if(s4_wfiles[i].stream==NULL) break;
+	if(i<S4_MAX_WFILES){
+		s4_wfiles[i].stream = stream;
+		s4_wfiles[i].name = strdup(filename);
+		s4_wfiles[i].fd = -1;
+		s4_wfiles[i].oldsum = sums;
+		s4_wfiles[i].oldpages = pages;
+	}
+	else free(sums);
+	pthread_mutex_unlock(&s4_flash_lock);
+	return stream;
+}
+
+int
+s4_fclose(FILE *stream)
+{
+	s4_wfile* wf;
+
+	pthread_mutex_lock(&s4_flash_lock);
+	s4_cache_flush(stream);
+	wf = s4_wfile_find(stream);
+	if(wf!=NULL){
+		if(wf->fd>=0) close(wf->fd);
+		free(wf->name);
+		free(wf->oldsum);
+		wf->oldsum = NULL;
+		wf->oldpages = 0;
+		wf->stream = NULL;
+	}
+	pthread_mutex_unlock(&s4_flash_lock);
+	return fclose(stream);
 }
 
 int
@@ -47,24 +518,342 @@ s4_rewind(FILE *stream)
 size_t
 s4_fread(void * ptr, size_t size, size_t nitems, FILE * stream)
 {
-        return fread(ptr,size,nitems,stream);
+	long offset = ftell(stream);
+	size_t n = fread(ptr,size,nitems,stream);
+
+	s4_read_charge(stream, offset, n*size);
+	return n;
 }
 
+// synchronous read of numPages pages into the front of s4_buffer.
+// it reuses the prefetch ring, so it fails while any page is still held.
 size_t
 s4_pageread(size_t pageStartNumber, size_t numPages, FILE * stream)
 {
-	int n = s4_fread(&s4_buffer[pageStartNumber],sizeof(char), S4_PAGE_SIZE*numPages,stream);
+	size_t i, n = 0, bytes;
+	int slot;
 
-	// modeling for clock tick delay
-	// default read time for a page is  internally 200us
-	s4_spend_time(S4_FLASH_READ_LATENCY);
+	if(numPages>S4_NUM_BUFFERS) numPages = S4_NUM_BUFFERS;
+	pthread_mutex_lock(&s4_flash_lock);
+	for(i=0;i<S4_NUM_BUFFERS;i++)
+		if(s4_ring[i].busy) break;
+	if(i==S4_NUM_BUFFERS) s4_ring_next = 0;
+	pthread_mutex_unlock(&s4_flash_lock);
+	if(i<S4_NUM_BUFFERS) return 0;
 
-	if(n%S4_PAGE_SIZE==0) return n/S4_PAGE_SIZE;
-	else return (n/S4_PAGE_SIZE)+1;
+	for(i=0;i<numPages;i++)
+		if(s4_prefetch(stream, pageStartNumber+i)<0) break;
+	numPages = i;
+	for(i=0;i<numPages;i++){
+		slot = (int)i;
+		if(s4_wait_page(slot, &bytes)!=NULL && bytes>0) n++;
+		s4_release_page(slot);
+	}
+	return n;
 }
 
 size_t
 s4_fwrite(const void * ptr, size_t size, size_t nitems, FILE * stream)
 {
-        return fwrite(ptr,size,nitems,stream);
+	long offset = ftell(stream);
+	size_t n = fwrite(ptr,size,nitems,stream);
+
+	s4_cache_write(stream, offset, n*size);
+	return n;
+}
+
+int
+s4_prefetch(FILE * stream, size_t pageNumber)
+{
+	long pos, offset = (long)(pageNumber*S4_PAGE_SIZE);
+	long long now;
+	size_t n;
+	int i, slot = -1;
+
+	pthread_mutex_lock(&s4_flash_lock);
+	for(i=0;i<S4_NUM_BUFFERS;i++){
+		if(!s4_ring[(s4_ring_next+i)%S4_NUM_BUFFERS].busy){
+			slot = (s4_ring_next+i)%S4_NUM_BUFFERS;
+			break;
+		}
+	}
+	if(slot<0){
+		pthread_mutex_unlock(&s4_flash_lock);
+		return -1;
+	}
+	s4_ring_next = (slot+1)%S4_NUM_BUFFERS;
+
+	// the data is copied now, only the model time is deferred to s4_wait_page
+	pos = ftell(stream);
+	n = 0;
+	if(fseek(stream, offset, SEEK_SET)==0)
+		n = fread(&s4_buffer[slot*S4_PAGE_SIZE], sizeof(char), S4_PAGE_SIZE, stream);
+	fseek(stream, pos, SEEK_SET);
+
+	now = s4_now();
+	s4_ring[slot].busy = 1;
+	s4_ring[slot].bytes = n;
+	s4_ring[slot].ready = n>0 ? s4_flash_access(stream, offset/S4_PAGE_SIZE, offset/S4_PAGE_SIZE, 0, now) : now;
+	s4_prefetch_pages++;
+	s4_prefetch_ticks += s4_ring[slot].ready-now;
+	s4_read_calls++;
+	s4_read_bytes += n;
+	pthread_mutex_unlock(&s4_flash_lock);
+	s4_account(n, 0, 0);
+	return slot;
+}
+
+char *
+s4_wait_page(int slot, size_t * nbytes)
+{
+	long long now;
+
+	if(slot<0 || slot>=S4_NUM_BUFFERS) return NULL;
+	pthread_mutex_lock(&s4_flash_lock);
+	if(!s4_ring[slot].busy){
+		pthread_mutex_unlock(&s4_flash_lock);
+		return NULL;
+	}
+	now = s4_now();
+	if(s4_ring[slot].ready>now){
+		s4_stall_ticks += s4_ring[slot].ready-now;
+		s4_read_ticks += s4_ring[slot].ready-now;
+		s4_tick_time += s4_ring[slot].ready-now;
+	}
+	s4_ring[slot].ready = now;
+	if(nbytes) *nbytes = s4_ring[slot].bytes;
+	pthread_mutex_unlock(&s4_flash_lock);
+	return &s4_buffer[slot*S4_PAGE_SIZE];
+}
+
+void
+s4_release_page(int slot)
+{
+	if(slot<0 || slot>=S4_NUM_BUFFERS) return;
+	pthread_mutex_lock(&s4_flash_lock);
+	s4_ring[slot].busy = 0;
+	pthread_mutex_unlock(&s4_flash_lock);
+}
+
+const void *
+s4_map(FILE * stream, long offset, size_t length)
+{
+	struct stat st;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	long align, pos;
+	long long now, done;
+	void* base;
+	int i, mapped = 1;
+
+	if(length==0 || offset<0) return NULL;
+	if(fstat(fileno(stream), &st)!=0 || (long long)offset+(long long)length>(long long)st.st_size) return NULL;
+	if(pagesize<=0) pagesize = 4096;
+
+	pthread_mutex_lock(&s4_flash_lock);
+	for(i=0;i<S4_MAX_MAPS;i++)
+		if(s4_maps[i].view==NULL) break;
+	if(i==S4_MAX_MAPS){
+		pthread_mutex_unlock(&s4_flash_lock);
+		return NULL;
+	}
+
+	// mmap wants a page aligned file offset
+	align = offset%pagesize;
+	base = mmap(NULL, length+align, PROT_READ, MAP_PRIVATE, fileno(stream), offset-align);
+	if(base==MAP_FAILED){
+		// no file backed mmap (e.g. older gem5 se mode), fall back to a private copy
+		mapped = 0;
+		align = 0;
+		base = malloc(length);
+		pos = ftell(stream);
+		if(base==NULL || fseek(stream, offset, SEEK_SET)!=0 || fread(base, 1, length, stream)!=length){
+			free(base);
+			fseek(stream, pos, SEEK_SET);
+			pthread_mutex_unlock(&s4_flash_lock);
+			return NULL;
+		}
+		fseek(stream, pos, SEEK_SET);
+	}
+	s4_maps[i].view = (const char*)base+align;
+	s4_maps[i].base = base;
+	s4_maps[i].length = length+align;
+	s4_maps[i].mapped = mapped;
+
+	// the simulator cannot trap the first touch, so every page of the view faults in up front,
+	// issued together the way a readahead window would be
+	now = s4_now();
+	done = s4_flash_access(stream, offset/S4_PAGE_SIZE, (long)((offset+length-1)/S4_PAGE_SIZE), 0, now);
+	s4_map_calls++;
+	s4_map_faults += (offset+length-1)/S4_PAGE_SIZE-offset/S4_PAGE_SIZE+1;
+	s4_map_ticks += done-now;
+	s4_read_ticks += done-now;
+	s4_tick_time += done-now;
+	pthread_mutex_unlock(&s4_flash_lock);
+	s4_account(length, 0, 0);
+	return s4_maps[i].view;
+}
+
+void
+s4_unmap(const void * view)
+{
+	int i;
+
+	if(view==NULL) return;
+	pthread_mutex_lock(&s4_flash_lock);
+	for(i=0;i<S4_MAX_MAPS;i++){
+		if(s4_maps[i].view==view){
+			if(s4_maps[i].mapped) munmap(s4_maps[i].base, s4_maps[i].length);
+			else free(s4_maps[i].base);
+			s4_maps[i].view = NULL;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&s4_flash_lock);
+}
+
+// the calling thread's slot, registered on first use. called with s4_region_lock held.
+static s4_thread* s4_thread_self()
+{
+	pthread_t self = pthread_self();
+	int i;
+
+	for(i=0;i<s4_thread_count;i++)
+		if(pthread_equal(s4_threads[i].id, self)) return &s4_threads[i];
+	if(s4_thread_count==S4_MAX_THREADS) return NULL;
+	s4_threads[s4_thread_count].id = self;
+	s4_threads[s4_thread_count].depth = 0;
+	return &s4_threads[s4_thread_count++];
+}
+
+static int s4_region_id(const char* name)
+{
+	int i;
+
+	for(i=1;i<s4_region_count;i++)
+		if(strcmp(s4_region_names[i], name)==0) return i;
+	if(s4_region_count==S4_MAX_REGIONS) return -1;
+	strncpy(s4_region_names[s4_region_count], name, sizeof(s4_region_names[0])-1);
+	return s4_region_count++;
+}
+
+static void s4_account(long long rbytes, long long wbytes, long long items)
+{
+	s4_thread* t;
+	int r;
+
+	pthread_mutex_lock(&s4_region_lock);
+	t = s4_thread_self();
+	if(t!=NULL){
+		t->stat[0].bytes_read += rbytes;
+		t->stat[0].bytes_written += wbytes;
+		t->stat[0].items += items;
+		if(t->depth>0){
+			r = t->stack[t->depth-1];
+			t->stat[r].bytes_read += rbytes;
+			t->stat[r].bytes_written += wbytes;
+			t->stat[r].items += items;
+		}
+	}
+	pthread_mutex_unlock(&s4_region_lock);
+}
+
+void s4_count_items(long long n)
+{
+	s4_account(0, 0, n);
+}
+
+void s4_region_begin(const char* name)
+{
+	s4_thread* t;
+	int r;
+
+	pthread_mutex_lock(&s4_region_lock);
+	t = s4_thread_self();
+	r = s4_region_id(name);
+	if(t==NULL || r<0 || t->depth==S4_MAX_REGION_DEPTH){
+		pthread_mutex_unlock(&s4_region_lock);
+		return;
+	}
+	t->stack[t->depth] = r;
+	t->start[t->depth] = s4_now();
+	t->iostart[t->depth] = s4_tick_time;
+	t->depth++;
+	pthread_mutex_unlock(&s4_region_lock);
+#ifdef S4_M5OPS
+	if(t->depth==1) m5_reset_stats(0, 0);
+#endif
+}
+
+void s4_region_end(const char* name)
+{
+	s4_thread* t;
+	long long now = s4_now();
+	int r, d;
+
+	pthread_mutex_lock(&s4_region_lock);
+	t = s4_thread_self();
+	r = s4_region_id(name);
+	if(t==NULL || r<0){
+		pthread_mutex_unlock(&s4_region_lock);
+		return;
+	}
+	for(d=t->depth-1;d>=0;d--)
+		if(t->stack[d]==r) break;
+	// regions left open inside this one end with it
+	while(d>=0 && t->depth>d){
+		t->depth--;
+		t->stat[t->stack[t->depth]].calls++;
+		t->stat[t->stack[t->depth]].ticks += now-t->start[t->depth];
+		t->stat[t->stack[t->depth]].io_ticks += s4_tick_time-t->iostart[t->depth];
+	}
+	pthread_mutex_unlock(&s4_region_lock);
+#ifdef S4_M5OPS
+	if(d==0) m5_dump_stats(0, 0);
+#endif
+}
+
+double s4_region_seconds(const char* name)
+{
+	long long ticks = 0;
+	int i, r;
+
+	pthread_mutex_lock(&s4_region_lock);
+	for(r=1;r<s4_region_count;r++)
+		if(strcmp(s4_region_names[r], name)==0) break;
+	if(r<s4_region_count)
+		for(i=0;i<s4_thread_count;i++)
+			ticks += s4_threads[i].stat[r].ticks;
+	pthread_mutex_unlock(&s4_region_lock);
+	return (double)ticks/1e12;
+}
+
+// one row per thread and region that was entered or charged, thread 0 is the first to use the api
+static void s4_write_regions()
+{
+	FILE* out;
+	s4_region_stat* s;
+	int i, r;
+
+	pthread_mutex_lock(&s4_region_lock);
+	if(s4_thread_count>0){
+		s4_threads[0].stat[0].calls = 1;
+		s4_threads[0].stat[0].ticks = s4_now();
+		s4_threads[0].stat[0].io_ticks = s4_tick_time;
+	}
+	out = fopen("io_regions.csv", "w");
+	if(out==NULL){
+		pthread_mutex_unlock(&s4_region_lock);
+		return;
+	}
+	fprintf(out, "region,thread,calls,ticks,io_ticks,bytes_read,bytes_written,items\n");
+	for(r=0;r<s4_region_count;r++){
+		for(i=0;i<s4_thread_count;i++){
+			s = &s4_threads[i].stat[r];
+			if(s->calls==0 && s->bytes_read==0 && s->bytes_written==0 && s->items==0) continue;
+			fprintf(out, "%s,%d,%lld,%lld,%lld,%lld,%lld,%lld\n", s4_region_names[r], i,
+				s->calls, s->ticks, s->io_ticks, s->bytes_read, s->bytes_written, s->items);
+		}
+	}
+	fclose(out);
+	pthread_mutex_unlock(&s4_region_lock);
 }
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "isp.h"
+
+// the job table grows on demand: more jobs than the first table size of 1024 are
+// submitted in native mode, every one must run and report its cycles.
+// a kernel that exits non zero must report its status and no cycles, and must not
+// leave the m5out/stats.txt of an earlier gem5 run in its directory.
+
+#define test_jobs 1100
+#define test_max_jobs 8
+
+void writekernel(const char* name, int status){
+	FILE* ofp=fopen(name, "w");
+	fprintf(ofp, "#!/bin/sh\nexit %d\n", status);
+	fclose(ofp);
+	chmod(name, 0755);
+}
+
+int main(int argc, const char* argv[])
+{
+	char workdir[64];
+	isp_job jobs[test_jobs], job;
+	int i, failed=0;
+	FILE* ofp;
+	writekernel("jobtest_kernel.host", 0);
+	writekernel("jobtest_fail.host", 3);
+	mkdir("jobtest", 0755);
+
+	ispSetRunMode(ISP_RUN_NATIVE);
+	ispSetMaxJobs(test_max_jobs);
+	for(i=0;i<test_jobs;i++){
+		sprintf(workdir, "jobtest/%d", i);
+		jobs[i]=ispSubmitBinaryFileEx(0, workdir, "jobtest_kernel", NULL, "output.txt", 2, "1GHz");
+		if(jobs[i]!=i){
+			printf("job %d: submit returned %d\n", i, jobs[i]);
+			failed++;
+		}
+	}
+	if(ispWaitAllJobs()!=0){
+		printf("ispWaitAllJobs reported failed jobs\n");
+		failed++;
+	}
+	for(i=0;i<test_jobs;i++){
+		if(jobs[i]<0) continue;
+		sprintf(workdir, "jobtest/%d", i);
+		if(ispPollJob(jobs[i])!=1 || ispJobCycle(jobs[i])<=0 || strstr(ispJobWorkdir(jobs[i]), workdir)==NULL){
+			printf("job %d: poll %d, cycle %lld, workdir %s\n", i, ispPollJob(jobs[i]), ispJobCycle(jobs[i]), ispJobWorkdir(jobs[i]));
+			failed++;
+		}
+	}
+
+	mkdir("jobtest/fail", 0755);
+	mkdir("jobtest/fail/m5out", 0755);
+	ofp=fopen("jobtest/fail/m5out/stats.txt", "w");
+	fprintf(ofp, "sim_ticks 1000\n");
+	fclose(ofp);
+	job=ispSubmitBinaryFileEx(0, "jobtest/fail", "jobtest_fail", NULL, "output.txt", 2, "1GHz");
+	if(ispWaitAllJobs()!=1 || ispJobStatus(job)!=3 || ispJobCycle(job)!=-1 || access("jobtest/fail/m5out/stats.txt", F_OK)==0){
+		printf("failing job: status %d, cycle %lld\n", ispJobStatus(job), ispJobCycle(job));
+		failed++;
+	}
+
+	printf("%s: %d jobs, %d failed\n", failed ? "FAIL" : "PASS", test_jobs, failed);
+	return failed ? 1 : 0;
+}
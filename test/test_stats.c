@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "isp_stats.h"
+
+// ispStatsCollectDir on a stats.txt with one dump, the whole run, and on one with
+// two S4_M5OPS region dumps followed by gem5's exit dump, which is left out.
+
+#define begin_dump "---------- Begin Simulation Statistics ----------\n"
+#define end_dump "---------- End Simulation Statistics   ----------\n\n"
+
+int failed=0;
+
+void writefile(const char* name, const char* text){
+	FILE* ofp=fopen(name, "w");
+	fputs(text, ofp);
+	fclose(ofp);
+}
+
+void expect(const char* stage, const char* name, long long value, long long expected){
+	if(value!=expected){
+		printf("%s: %s %lld, expected %lld\n", stage, name, value, expected);
+		failed++;
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	isp_stage_stats* s;
+	mkdir("statstest", 0755);
+	mkdir("statstest/whole", 0755);
+	mkdir("statstest/whole/m5out", 0755);
+	mkdir("statstest/regions", 0755);
+	mkdir("statstest/regions/m5out", 0755);
+
+	writefile("statstest/whole/m5out/stats.txt", begin_dump
+		"sim_ticks                 5000   # Number of ticks simulated\n"
+		"sim_insts                 700    # Number of instructions simulated\n"
+		"system.cpu0.icache.overall_misses::total 3\n"
+		"system.cpu1.icache.overall_misses::total 4\n"
+		"system.cpu0.dcache.overall_misses::total 5\n"
+		"system.l2.overall_misses::total 6\n"
+		end_dump);
+	writefile("statstest/whole/gem5_result.txt", "Exiting @ tick 5100 because exiting with last active thread context\n");
+	writefile("statstest/whole/io_stat.txt", "Exiting @ tick 900\ns4.read_pages 12\ns4.program_pages 2\n");
+
+	// gem5 names of both versions, the exit dump repeats the second region and the tail
+	writefile("statstest/regions/m5out/stats.txt", begin_dump
+		"sim_ticks 1000\n"
+		"sim_insts 100\n"
+		"system.cpu.icache.overall_misses::total 1\n"
+		"system.cpu.dcache.overall_misses::total 10\n"
+		"system.l2.overall_misses::total 100\n"
+		end_dump begin_dump
+		"sim_ticks 2000\n"
+		"sim_insts 200\n"
+		"system.cpu.icache.overallMisses::total 2\n"
+		"system.cpu.dcache.overallMisses::total 20\n"
+		"system.l2.overallMisses::total 200\n"
+		end_dump begin_dump
+		"sim_ticks 2500\n"
+		"sim_insts 250\n"
+		"system.cpu.icache.overallMisses::total 3\n"
+		"system.cpu.dcache.overallMisses::total 30\n"
+		"system.l2.overallMisses::total 300\n"
+		end_dump);
+	writefile("statstest/regions/gem5_result.txt", "Exiting @ tick 4000 because exiting with last active thread context\n");
+
+	s=ispStatsCollectDir("whole", "statstest/whole");
+	expect("whole", "sim_ticks", s->sim_ticks, 5000);
+	expect("whole", "sim_insts", s->sim_insts, 700);
+	expect("whole", "icache_misses", s->icache_misses, 7);
+	expect("whole", "dcache_misses", s->dcache_misses, 5);
+	expect("whole", "l2_misses", s->l2_misses, 6);
+	expect("whole", "regions", s->regions, 0);
+	expect("whole", "exit_tick", s->exit_tick, 5100);
+	expect("whole", "io_ticks", s->io_ticks, 900);
+	expect("whole", "read_pages", s->read_pages, 12);
+	expect("whole", "program_pages", s->program_pages, 2);
+
+	s=ispStatsCollectDir("regions", "statstest/regions");
+	expect("regions", "sim_ticks", s->sim_ticks, 3000);
+	expect("regions", "sim_insts", s->sim_insts, 300);
+	expect("regions", "icache_misses", s->icache_misses, 3);
+	expect("regions", "dcache_misses", s->dcache_misses, 30);
+	expect("regions", "l2_misses", s->l2_misses, 300);
+	expect("regions", "regions", s->regions, 2);
+	expect("regions", "exit_tick", s->exit_tick, 4000);
+	expect("regions", "io_ticks", s->io_ticks, 0);
+
+	expect("total", "ticks", ispStatsTotalTicks(), 5100+900+4000);
+	expect("count", "stages", ispStatsCount(), 2);
+
+	printf("%s: stats parser, %d failed\n", failed ? "FAIL" : "PASS", failed);
+	return failed ? 1 : 0;
+}